@@ -0,0 +1,247 @@
+/*
+ * SIMD versions of CRC32 and Adler-32 checksums for zlib.
+ * For details and updates please visit
+ * https://github.com/gildor2/fast_zlib
+ * Licensed under the BSD license. See LICENSE.txt file in the project root for full license information.
+ */
+
+#include "cpu_features.h"
+#include "checksum_simd.h"
+
+#if X86_CPU
+
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#include <smmintrin.h>
+#include <wmmintrin.h>
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+#define ALIGN16(decl)       __declspec(align(16)) decl
+#else
+#define ALIGN16(decl)       decl __attribute__((aligned(16)))
+#endif
+
+/*-----------------------------------------------------------------------------
+    CRC32
+-----------------------------------------------------------------------------*/
+
+/* Folding of 4 128-bit lanes with PCLMULQDQ, based on Intel's paper "Fast CRC Computation
+ * for Generic Polynomials Using PCLMULQDQ Instruction". Constants are for bit-reflected
+ * CRC32 polynomial 0x04C11DB7.
+ */
+TARGET_PCLMUL
+unsigned long crc32_pclmul(unsigned long crc, const unsigned char *buf, size_t len)
+{
+    static const ALIGN16(unsigned long long k1k2[2]) = { 0x0154442bd4ULL, 0x01c6e41596ULL };
+    static const ALIGN16(unsigned long long k3k4[2]) = { 0x01751997d0ULL, 0x00ccaa009eULL };
+    static const ALIGN16(unsigned long long k5k0[2]) = { 0x0163cd6124ULL, 0x0000000000ULL };
+    static const ALIGN16(unsigned long long poly[2]) = { 0x01db710641ULL, 0x01f7011641ULL };
+
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8;
+
+    /* first 64 bytes, xor'ed with inverted crc */
+    x1 = _mm_loadu_si128((const __m128i*)(buf + 0x00));
+    x2 = _mm_loadu_si128((const __m128i*)(buf + 0x10));
+    x3 = _mm_loadu_si128((const __m128i*)(buf + 0x20));
+    x4 = _mm_loadu_si128((const __m128i*)(buf + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)(unsigned)~crc));
+
+    x0 = _mm_load_si128((const __m128i*)k1k2);
+    buf += 64;
+    len -= 64;
+
+    /* fold 64 bytes per iteration */
+    while (len >= 64) {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i*)(buf + 0x00)));
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i*)(buf + 0x10)));
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i*)(buf + 0x20)));
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i*)(buf + 0x30)));
+
+        buf += 64;
+        len -= 64;
+    }
+
+    /* fold 4 lanes into one */
+    x0 = _mm_load_si128((const __m128i*)k3k4);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    /* fold remaining 16-byte blocks */
+    while (len >= 16) {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, _mm_loadu_si128((const __m128i*)buf)), x5);
+        buf += 16;
+        len -= 16;
+    }
+
+    /* fold 128 bits to 64 bits */
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x1 = _mm_srli_si128(x1, 8);
+    x1 = _mm_xor_si128(x1, x2);
+
+    x0 = _mm_loadl_epi64((const __m128i*)k5k0);
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, x3);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    /* Barrett reduction to 32 bits */
+    x0 = _mm_load_si128((const __m128i*)poly);
+    x2 = _mm_and_si128(x1, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    return ~(unsigned)_mm_extract_epi32(x1, 1) & 0xffffffffUL;
+}
+
+/*-----------------------------------------------------------------------------
+    Adler-32
+-----------------------------------------------------------------------------*/
+
+#define BASE    65521U      /* largest prime smaller than 65536 */
+#define NMAX    5552        /* the same as in adler32.c */
+
+/* Processes data in 32-byte blocks: s1 is a sum of bytes, and s2 is a sum of bytes multiplied
+ * by their distance to the block end, plus 32 * (value of s1 at the start of each block).
+ */
+#define ADLER_BLOCK     32
+
+static unsigned long adler32_tail(unsigned s1, unsigned s2, const unsigned char *buf, size_t len)
+{
+    while (len--) {
+        s1 += *buf++;
+        s2 += s1;
+    }
+    s1 %= BASE;
+    s2 %= BASE;
+    return s1 | ((unsigned long)s2 << 16);
+}
+
+TARGET_SSSE3
+unsigned long adler32_ssse3(unsigned long adler, const unsigned char *buf, size_t len)
+{
+    unsigned s1 = adler & 0xffff;
+    unsigned s2 = (adler >> 16) & 0xffff;
+    size_t blocks = len / ADLER_BLOCK;
+    len -= blocks * ADLER_BLOCK;
+
+    while (blocks) {
+        const __m128i tap1 = _mm_setr_epi8(32,31,30,29,28,27,26,25,24,23,22,21,20,19,18,17);
+        const __m128i tap2 = _mm_setr_epi8(16,15,14,13,12,11,10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i ones = _mm_set1_epi16(1);
+        __m128i v_ps, v_s1, v_s2;
+
+        /* at most NMAX bytes could be processed before s2 must be reduced modulo BASE */
+        unsigned n = NMAX / ADLER_BLOCK;
+        if (n > blocks) n = (unsigned)blocks;
+        blocks -= n;
+
+        v_ps = _mm_cvtsi32_si128((int)(s1 * n));
+        v_s2 = _mm_cvtsi32_si128((int)s2);
+        v_s1 = _mm_setzero_si128();
+
+        do {
+            const __m128i bytes1 = _mm_loadu_si128((const __m128i*)buf);
+            const __m128i bytes2 = _mm_loadu_si128((const __m128i*)(buf + 16));
+            /* s1 of previous blocks goes to s2 */
+            v_ps = _mm_add_epi32(v_ps, v_s1);
+            v_s1 = _mm_add_epi32(v_s1, _mm_sad_epu8(bytes1, zero));
+            v_s2 = _mm_add_epi32(v_s2, _mm_madd_epi16(_mm_maddubs_epi16(bytes1, tap1), ones));
+            v_s1 = _mm_add_epi32(v_s1, _mm_sad_epu8(bytes2, zero));
+            v_s2 = _mm_add_epi32(v_s2, _mm_madd_epi16(_mm_maddubs_epi16(bytes2, tap2), ones));
+            buf += ADLER_BLOCK;
+        } while (--n);
+
+        v_s2 = _mm_add_epi32(v_s2, _mm_slli_epi32(v_ps, 5));
+
+        /* horizontal sums */
+        v_s1 = _mm_add_epi32(v_s1, _mm_shuffle_epi32(v_s1, _MM_SHUFFLE(1,0,3,2)));
+        s1 += (unsigned)_mm_cvtsi128_si32(v_s1);
+        v_s2 = _mm_add_epi32(v_s2, _mm_shuffle_epi32(v_s2, _MM_SHUFFLE(2,3,0,1)));
+        v_s2 = _mm_add_epi32(v_s2, _mm_shuffle_epi32(v_s2, _MM_SHUFFLE(1,0,3,2)));
+        s2 = (unsigned)_mm_cvtsi128_si32(v_s2);
+
+        s1 %= BASE;
+        s2 %= BASE;
+    }
+
+    return adler32_tail(s1, s2, buf, len);
+}
+
+TARGET_AVX2
+static unsigned hsum256(__m256i v)
+{
+    __m128i x = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    x = _mm_add_epi32(x, _mm_shuffle_epi32(x, _MM_SHUFFLE(2,3,0,1)));
+    x = _mm_add_epi32(x, _mm_shuffle_epi32(x, _MM_SHUFFLE(1,0,3,2)));
+    return (unsigned)_mm_cvtsi128_si32(x);
+}
+
+TARGET_AVX2
+unsigned long adler32_avx2(unsigned long adler, const unsigned char *buf, size_t len)
+{
+    unsigned s1 = adler & 0xffff;
+    unsigned s2 = (adler >> 16) & 0xffff;
+    size_t blocks = len / ADLER_BLOCK;
+    len -= blocks * ADLER_BLOCK;
+
+    while (blocks) {
+        const __m256i tap = _mm256_setr_epi8(32,31,30,29,28,27,26,25,24,23,22,21,20,19,18,17,
+                                             16,15,14,13,12,11,10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i ones = _mm256_set1_epi16(1);
+        __m256i v_ps, v_s1, v_s2;
+
+        unsigned n = NMAX / ADLER_BLOCK;
+        if (n > blocks) n = (unsigned)blocks;
+        blocks -= n;
+        s2 += s1 * n * ADLER_BLOCK;
+
+        v_ps = _mm256_setzero_si256();
+        v_s1 = _mm256_setzero_si256();
+        v_s2 = _mm256_setzero_si256();
+
+        do {
+            const __m256i bytes = _mm256_loadu_si256((const __m256i*)buf);
+            v_ps = _mm256_add_epi32(v_ps, v_s1);
+            v_s1 = _mm256_add_epi32(v_s1, _mm256_sad_epu8(bytes, zero));
+            v_s2 = _mm256_add_epi32(v_s2, _mm256_madd_epi16(_mm256_maddubs_epi16(bytes, tap), ones));
+            buf += ADLER_BLOCK;
+        } while (--n);
+
+        s2 += hsum256(v_s2) + (hsum256(v_ps) << 5);
+        s1 += hsum256(v_s1);
+        s1 %= BASE;
+        s2 %= BASE;
+    }
+
+    return adler32_tail(s1, s2, buf, len);
+}
+
+#endif /* X86_CPU */
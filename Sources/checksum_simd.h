@@ -0,0 +1,35 @@
+/*
+ * SIMD versions of CRC32 and Adler-32 checksums for zlib.
+ * For details and updates please visit
+ * https://github.com/gildor2/fast_zlib
+ * Licensed under the BSD license. See LICENSE.txt file in the project root for full license information.
+ */
+
+#ifndef CHECKSUM_SIMD_H
+#define CHECKSUM_SIMD_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Minimal data size for SIMD code, shorter buffers are processed faster with generic code */
+#define CRC32_SIMD_MIN_LEN      64
+#define ADLER32_SIMD_MIN_LEN    64
+
+/* CRC32 with carry-less multiplication folding. Requires CPU_PCLMUL and CPU_SSE41.
+ * len should be a multiple of 16 and not less than CRC32_SIMD_MIN_LEN. Receives and
+ * returns a regular (not inverted) crc value, the same as zlib's crc32().
+ */
+unsigned long crc32_pclmul(unsigned long crc, const unsigned char *buf, size_t len);
+
+/* Adler-32 of the whole buffer, may be used for any len. Requires CPU_SSSE3 or CPU_AVX2. */
+unsigned long adler32_ssse3(unsigned long adler, const unsigned char *buf, size_t len);
+unsigned long adler32_avx2(unsigned long adler, const unsigned char *buf, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CHECKSUM_SIMD_H */
@@ -0,0 +1,78 @@
+/*
+ * Runtime detection of CPU features used by SIMD code paths.
+ * For details and updates please visit
+ * https://github.com/gildor2/fast_zlib
+ * Licensed under the BSD license. See LICENSE.txt file in the project root for full license information.
+ */
+
+#include "cpu_features.h"
+
+#if X86_CPU
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#define cpuid(info, leaf)   __cpuidex(info, leaf, 0)
+#define xgetbv0()           _xgetbv(0)
+#else
+#include <cpuid.h>
+
+static void cpuid(int info[4], int leaf)
+{
+    unsigned a = 0, b = 0, c = 0, d = 0;
+    __cpuid_count(leaf, 0, a, b, c, d);
+    info[0] = a; info[1] = b; info[2] = c; info[3] = d;
+}
+
+static unsigned long long xgetbv0(void)
+{
+    unsigned a, d;
+    __asm__ __volatile__ ("xgetbv" : "=a"(a), "=d"(d) : "c"(0));
+    return ((unsigned long long)d << 32) | a;
+}
+#endif /* _MSC_VER */
+
+static unsigned detect_features(void)
+{
+    int info[4];
+    unsigned features = 0;
+    int maxLeaf;
+
+    cpuid(info, 0);
+    maxLeaf = info[0];
+    if (maxLeaf < 1) return 0;
+
+    cpuid(info, 1);
+    if (info[3] & (1 << 26)) features |= CPU_SSE2;
+    if (info[2] & (1 << 9))  features |= CPU_SSSE3;
+    if (info[2] & (1 << 19)) features |= CPU_SSE41;
+    if (info[2] & (1 << 1))  features |= CPU_PCLMUL;
+
+    /* AVX2 requires OS support for saving YMM registers */
+    if ((info[2] & (1 << 27)) && (info[2] & (1 << 28)) && maxLeaf >= 7 &&
+        (xgetbv0() & 6) == 6) {
+        cpuid(info, 7);
+        if (info[1] & (1 << 5)) features |= CPU_AVX2;
+    }
+    return features;
+}
+
+#else
+
+static unsigned detect_features(void)
+{
+    return 0;
+}
+
+#endif /* X86_CPU */
+
+unsigned cpu_features(void)
+{
+    /* Detection is cheap and gives the same result in all threads, so no locking here */
+    static volatile int detected = 0;
+    static volatile unsigned features = 0;
+    if (!detected) {
+        features = detect_features();
+        detected = 1;
+    }
+    return features;
+}
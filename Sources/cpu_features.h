@@ -0,0 +1,47 @@
+/*
+ * Runtime detection of CPU features used by SIMD code paths.
+ * For details and updates please visit
+ * https://github.com/gildor2/fast_zlib
+ * Licensed under the BSD license. See LICENSE.txt file in the project root for full license information.
+ */
+
+#ifndef CPU_FEATURES_H
+#define CPU_FEATURES_H
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define X86_CPU 1
+#endif
+
+/* Allow use of intrinsics for a particular instruction set in a single function,
+ * without compiling the whole file for it. Visual C++ doesn't need this.
+ */
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_SSE2         __attribute__((target("sse2")))
+#define TARGET_SSSE3        __attribute__((target("ssse3")))
+#define TARGET_AVX2         __attribute__((target("avx2")))
+#define TARGET_PCLMUL       __attribute__((target("sse4.1,pclmul")))
+#else
+#define TARGET_SSE2
+#define TARGET_SSSE3
+#define TARGET_AVX2
+#define TARGET_PCLMUL
+#endif
+
+#define CPU_SSE2            0x0001
+#define CPU_SSSE3           0x0002
+#define CPU_SSE41           0x0004
+#define CPU_PCLMUL          0x0008
+#define CPU_AVX2            0x0010
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Returns a combination of CPU_xxx flags, 0 for non-x86 platforms. */
+unsigned cpu_features(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CPU_FEATURES_H */
@@ -0,0 +1,266 @@
+/*
+ * Batch compression of many small independent buffers.
+ * For details and updates please visit
+ * https://github.com/gildor2/fast_zlib
+ * Licensed under the BSD license. See LICENSE.txt file in the project root for full license information.
+ */
+
+#include <stdlib.h>
+
+#include "deflate_pool.h"
+#include "deflate_batch.h"
+
+#if defined(_WIN32)
+#   include <windows.h>
+#   if defined(_WIN32_WINNT) && _WIN32_WINNT >= 0x0600
+#       define BATCH_THREADS 1          /* condition variables require Vista */
+#   endif
+#else
+#   include <pthread.h>
+#   define BATCH_THREADS 1
+#endif
+
+#ifndef local
+#define local static
+#endif
+
+/* Number of items taken by a thread at once */
+#define BATCH_CHUNK     16
+
+#ifdef BATCH_THREADS
+
+#ifdef _WIN32
+typedef CRITICAL_SECTION    batch_mutex;
+typedef CONDITION_VARIABLE  batch_cond;
+typedef HANDLE              batch_thread;
+#define mutex_init(m)       InitializeCriticalSection(m)
+#define mutex_destroy(m)    DeleteCriticalSection(m)
+#define mutex_lock(m)       EnterCriticalSection(m)
+#define mutex_unlock(m)     LeaveCriticalSection(m)
+#define cond_init(c)        InitializeConditionVariable(c)
+#define cond_destroy(c)
+#define cond_wait(c, m)     SleepConditionVariableCS(c, m, INFINITE)
+#define cond_broadcast(c)   WakeAllConditionVariable(c)
+#else
+typedef pthread_mutex_t     batch_mutex;
+typedef pthread_cond_t      batch_cond;
+typedef pthread_t           batch_thread;
+#define mutex_init(m)       pthread_mutex_init(m, NULL)
+#define mutex_destroy(m)    pthread_mutex_destroy(m)
+#define mutex_lock(m)       pthread_mutex_lock(m)
+#define mutex_unlock(m)     pthread_mutex_unlock(m)
+#define cond_init(c)        pthread_cond_init(c, NULL)
+#define cond_destroy(c)     pthread_cond_destroy(c)
+#define cond_wait(c, m)     pthread_cond_wait(c, m)
+#define cond_broadcast(c)   pthread_cond_broadcast(c)
+#endif
+
+typedef struct {
+    deflate_batch *batch;
+    deflate_pool *pool;
+    batch_thread thread;
+} batch_worker;
+
+#endif /* BATCH_THREADS */
+
+struct deflate_batch_s {
+    deflate_pool *pool;                 /* stream of the calling thread */
+    unsigned numThreads;
+#ifdef BATCH_THREADS
+    batch_worker *workers;
+    batch_mutex lock;
+    batch_cond wake;                    /* signalled when a new batch is started */
+    batch_cond done;                    /* signalled when the last worker has finished */
+    unsigned generation;                /* incremented for every batch */
+    unsigned active;                    /* workers which are still processing the batch */
+    int quit;
+    deflate_batch_item *items;
+    unsigned count;
+    unsigned next;                      /* first item which is not taken by any thread */
+#endif
+};
+
+local void batch_compress_items(deflate_pool *pool, deflate_batch_item *items, unsigned count)
+{
+    unsigned i;
+    for (i = 0; i < count; i++) {
+        deflate_batch_item *item = &items[i];
+        item->result = deflatePoolCompress(pool, item->dest, &item->destLen,
+                                           item->source, item->sourceLen);
+    }
+}
+
+#ifdef BATCH_THREADS
+
+/* Take chunks of items until all of them are taken. Called with unlocked mutex. */
+local void batch_process(deflate_batch *batch, deflate_pool *pool)
+{
+    for (;;) {
+        unsigned first, count;
+        mutex_lock(&batch->lock);
+        first = batch->next;
+        count = batch->count - first;
+        if (count > BATCH_CHUNK) count = BATCH_CHUNK;
+        batch->next = first + count;
+        mutex_unlock(&batch->lock);
+        if (!count) break;
+        batch_compress_items(pool, batch->items + first, count);
+    }
+}
+
+#ifdef _WIN32
+local DWORD WINAPI batch_thread_proc(LPVOID param)
+#else
+local void *batch_thread_proc(void *param)
+#endif
+{
+    batch_worker *worker = (batch_worker *)param;
+    deflate_batch *batch = worker->batch;
+    unsigned seen = 0;
+
+    mutex_lock(&batch->lock);
+    for (;;) {
+        while (batch->generation == seen && !batch->quit)
+            cond_wait(&batch->wake, &batch->lock);
+        if (batch->quit) break;
+        seen = batch->generation;
+        mutex_unlock(&batch->lock);
+
+        batch_process(batch, worker->pool);
+
+        mutex_lock(&batch->lock);
+        if (--batch->active == 0)
+            cond_broadcast(&batch->done);
+    }
+    mutex_unlock(&batch->lock);
+    return 0;
+}
+
+local int batch_start_threads(deflate_batch *batch, int level, int windowBits,
+                              int memLevel, int strategy, unsigned numThreads)
+{
+    unsigned i;
+
+    batch->workers = (batch_worker *)calloc(numThreads, sizeof(batch_worker));
+    if (batch->workers == NULL) return 0;
+    mutex_init(&batch->lock);
+    cond_init(&batch->wake);
+    cond_init(&batch->done);
+
+    for (i = 0; i < numThreads; i++) {
+        batch_worker *worker = &batch->workers[i];
+        worker->batch = batch;
+        worker->pool = deflatePoolCreate(level, windowBits, memLevel, strategy, 1);
+        if (worker->pool == Z_NULL) break;
+#ifdef _WIN32
+        worker->thread = CreateThread(NULL, 0, batch_thread_proc, worker, 0, NULL);
+        if (worker->thread == NULL) {
+#else
+        if (pthread_create(&worker->thread, NULL, batch_thread_proc, worker) != 0) {
+#endif
+            deflatePoolDestroy(worker->pool);
+            break;
+        }
+        batch->numThreads++;
+    }
+    return 1;
+}
+
+local void batch_stop_threads(deflate_batch *batch)
+{
+    unsigned i;
+    if (batch->workers == NULL) return;
+
+    mutex_lock(&batch->lock);
+    batch->quit = 1;
+    cond_broadcast(&batch->wake);
+    mutex_unlock(&batch->lock);
+
+    for (i = 0; i < batch->numThreads; i++) {
+        batch_worker *worker = &batch->workers[i];
+#ifdef _WIN32
+        WaitForSingleObject(worker->thread, INFINITE);
+        CloseHandle(worker->thread);
+#else
+        pthread_join(worker->thread, NULL);
+#endif
+        deflatePoolDestroy(worker->pool);
+    }
+    cond_destroy(&batch->done);
+    cond_destroy(&batch->wake);
+    mutex_destroy(&batch->lock);
+    free(batch->workers);
+}
+
+#endif /* BATCH_THREADS */
+
+/* ========================================================================= */
+deflate_batch * ZEXPORT deflateBatchCreate(int level, int windowBits, int memLevel,
+                                           int strategy, unsigned numThreads)
+{
+    deflate_batch *batch = (deflate_batch *)calloc(1, sizeof(deflate_batch));
+    if (batch == Z_NULL) return Z_NULL;
+
+    batch->pool = deflatePoolCreate(level, windowBits, memLevel, strategy, 1);
+    if (batch->pool == Z_NULL) {
+        free(batch);
+        return Z_NULL;
+    }
+#ifdef BATCH_THREADS
+    if (numThreads && !batch_start_threads(batch, level, windowBits, memLevel,
+                                           strategy, numThreads)) {
+        deflatePoolDestroy(batch->pool);
+        free(batch);
+        return Z_NULL;
+    }
+#else
+    (void)numThreads;
+#endif
+    return batch;
+}
+
+/* ========================================================================= */
+void ZEXPORT deflateBatchDestroy(deflate_batch *batch)
+{
+    if (batch == Z_NULL) return;
+#ifdef BATCH_THREADS
+    batch_stop_threads(batch);
+#endif
+    deflatePoolDestroy(batch->pool);
+    free(batch);
+}
+
+/* ========================================================================= */
+int ZEXPORT deflateBatchCompress(deflate_batch *batch, deflate_batch_item *items,
+                                 unsigned count)
+{
+    unsigned i;
+
+#ifdef BATCH_THREADS
+    /* small batches are not worth waking up the threads */
+    if (batch->numThreads && count > BATCH_CHUNK) {
+        mutex_lock(&batch->lock);
+        batch->items = items;
+        batch->count = count;
+        batch->next = 0;
+        batch->active = batch->numThreads;
+        batch->generation++;
+        cond_broadcast(&batch->wake);
+        mutex_unlock(&batch->lock);
+
+        batch_process(batch, batch->pool);
+
+        mutex_lock(&batch->lock);
+        while (batch->active)
+            cond_wait(&batch->done, &batch->lock);
+        batch->items = Z_NULL;
+        mutex_unlock(&batch->lock);
+    } else
+#endif
+    batch_compress_items(batch->pool, items, count);
+
+    for (i = 0; i < count; i++) {
+        if (items[i].result != Z_OK) return items[i].result;
+    }
+    return Z_OK;
+}
@@ -0,0 +1,59 @@
+/*
+ * Batch compression of many small independent buffers.
+ * For details and updates please visit
+ * https://github.com/gildor2/fast_zlib
+ * Licensed under the BSD license. See LICENSE.txt file in the project root for full license information.
+ */
+
+#ifndef DEFLATE_BATCH_H
+#define DEFLATE_BATCH_H
+
+#include "zlib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Compressing each of many small messages with compress2() pays for deflateInit()
+ * and deflateEnd() every time. A batch compresses an array of independent inputs
+ * into independent outputs (each one is a complete zlib stream, the same as produced
+ * by compress2()), reusing one deflate stream per thread through deflate_pool.
+ * Optionally, the work is spread across a pool of worker threads which is created
+ * once with the batch object. The calling thread participates in compression too.
+ *
+ * A batch object should be used from one thread at a time.
+ */
+
+typedef struct deflate_batch_item_s {
+    const Bytef *source;
+    uLong sourceLen;
+    Bytef *dest;
+    uLongf destLen;                     /* in: size of dest, out: size of compressed data */
+    int result;                         /* out: the same as compress2() result */
+} deflate_batch_item;
+
+typedef struct deflate_batch_s deflate_batch;
+
+ZEXTERN deflate_batch * ZEXPORT deflateBatchCreate OF((int level, int windowBits,
+                                                       int memLevel, int strategy,
+                                                       unsigned numThreads));
+/* Create a batch compressor; parameters have the same meaning as for deflateInit2().
+ * numThreads is the number of additional worker threads, 0 means compression in the
+ * calling thread only. Threads are not supported on platforms without pthreads or
+ * Windows Vista API, numThreads is ignored there. Returns Z_NULL when out of memory.
+ */
+
+ZEXTERN int ZEXPORT deflateBatchCompress OF((deflate_batch *batch,
+                                             deflate_batch_item *items, unsigned count));
+/* Compress all items, returns Z_OK when all of them succeeded, otherwise the error
+ * of the first failed item. Results of individual items are in their "result" field.
+ */
+
+ZEXTERN void ZEXPORT deflateBatchDestroy OF((deflate_batch *batch));
+/* Stop worker threads and free all resources. */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DEFLATE_BATCH_H */
@@ -0,0 +1,324 @@
+/*
+ * Long-range deduplication pre-pass for deflate.
+ * For details and updates please visit
+ * https://github.com/gildor2/fast_zlib
+ * Licensed under the BSD license. See LICENSE.txt file in the project root for full license information.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "deflate_dedup.h"
+
+#ifndef local
+#define local static
+#endif
+
+#define DEDUP_MAGIC         "FZDD"
+#define DEDUP_VERSION       1
+#define DEDUP_HEADER        56          /* magic, version and 6 numbers */
+
+#define DEDUP_WINDOW        64          /* bytes covered by the rolling hash */
+#define DEDUP_TAG_BITS      6           /* positions with zero top bits are indexed, 1 of 64 */
+#define DEDUP_MIN_MATCH     128         /* shorter matches cost more than they save */
+#define DEDUP_MIN_DIST      32768       /* closer matches are left to deflate */
+#define DEDUP_MAX_REF       30          /* 3 LEB128 numbers, up to 10 bytes each */
+
+typedef unsigned long long dedup_hash;
+
+/* ===========================================================================
+ * Helpers
+ */
+
+local void put_u32(Bytef *p, unsigned v)
+{
+    p[0] = (Bytef)v;
+    p[1] = (Bytef)(v >> 8);
+    p[2] = (Bytef)(v >> 16);
+    p[3] = (Bytef)(v >> 24);
+}
+
+local unsigned get_u32(const Bytef *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned)p[3] << 24);
+}
+
+local void put_u64(Bytef *p, uLong v)
+{
+    dedup_hash x = v;
+    put_u32(p, (unsigned)x);
+    put_u32(p + 4, (unsigned)(x >> 32));
+}
+
+/* Returns 0 when the value doesn't fit uLong */
+local int get_u64(const Bytef *p, uLong *v)
+{
+    dedup_hash x = get_u32(p) | ((dedup_hash)get_u32(p + 4) << 32);
+    *v = (uLong)x;
+    return *v == x;
+}
+
+local Bytef *put_varint(Bytef *p, uLong v)
+{
+    while (v >= 0x80) {
+        *p++ = (Bytef)(v | 0x80);
+        v >>= 7;
+    }
+    *p++ = (Bytef)v;
+    return p;
+}
+
+/* Returns 0 for truncated or too large number */
+local int get_varint(const Bytef **p, const Bytef *end, uLong *v)
+{
+    uLong x = 0;
+    int shift;
+    for (shift = 0; *p < end && shift < (int)sizeof(uLong) * 8; shift += 7) {
+        Bytef b = *(*p)++;
+        x |= (uLong)(b & 0x7F) << shift;
+        if (!(b & 0x80)) {
+            *v = x;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Fixed sequence, so the same data is indexed at the same positions by every build */
+local void dedup_gear_init(dedup_hash *gear)
+{
+    dedup_hash seed = 0x9E3779B97F4A7C15ULL;
+    int i;
+    for (i = 0; i < 256; i++) {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        gear[i] = seed;
+    }
+}
+
+local uLong dedup_refs_bound(uLong sourceLen)
+{
+    return (sourceLen / DEDUP_MIN_MATCH + 1) * DEDUP_MAX_REF;
+}
+
+/* ===========================================================================
+ * Compression
+ */
+
+uLong ZEXPORT compressDedupBound(sourceLen)
+    uLong sourceLen;
+{
+    return DEDUP_HEADER + compressBound(dedup_refs_bound(sourceLen)) + compressBound(sourceLen);
+}
+
+int ZEXPORT compressDedup(dest, destLen, source, sourceLen, level, tableBits)
+    Bytef *dest;
+    uLongf *destLen;
+    const Bytef *source;
+    uLong sourceLen;
+    int level;
+    int tableBits;
+{
+    dedup_hash gear[256];
+    dedup_hash hash = 0;
+    uLong *table;
+    Bytef *residual, *refs, *ref;
+    uLong lit = 0, out = 0, count = 0;
+    uLong i, primed = 0;
+    uLongf refsSize, residualSize;
+    int err;
+
+    if (tableBits < 16 || tableBits > 28) return Z_STREAM_ERROR;
+    if (*destLen < DEDUP_HEADER) return Z_BUF_ERROR;
+
+    /* table keeps position + 1 of the last byte of a window, 0 is an empty slot */
+    table = (uLong *)calloc((size_t)1 << tableBits, sizeof(uLong));
+    residual = (Bytef *)malloc(sourceLen ? sourceLen : 1);
+    refs = (Bytef *)malloc(dedup_refs_bound(sourceLen));
+    if (table == NULL || residual == NULL || refs == NULL) {
+        err = Z_MEM_ERROR;
+        goto done;
+    }
+    dedup_gear_init(gear);
+
+    ref = refs;
+    for (i = 0; i < sourceLen; i++) {
+        uLong slot, cand, s, r, len;
+
+        /* 64-bit gear hash depends on the last 64 bytes only */
+        hash = (hash << 1) + gear[source[i]];
+        if (++primed < DEDUP_WINDOW || (hash >> (64 - DEDUP_TAG_BITS)) != 0) continue;
+
+        slot = (uLong)((hash * 0x9E3779B97F4A7C15ULL) >> (64 - tableBits));
+        cand = table[slot];
+        table[slot] = i + 1;
+        if (cand == 0 || i + 1 - cand <= DEDUP_MIN_DIST) continue;
+
+        /* verify the window and extend the match forward */
+        s = i + 1 - DEDUP_WINDOW;
+        r = cand - DEDUP_WINDOW;
+        for (len = 0; s + len < sourceLen && source[r + len] == source[s + len]; len++) {}
+        if (len < DEDUP_WINDOW) continue;       /* hash collision */
+        /* and backward, up to the data which is already consumed */
+        while (s > lit && r > 0 && source[s - 1] == source[r - 1]) {
+            s--;
+            r--;
+            len++;
+        }
+        if (len < DEDUP_MIN_MATCH) continue;
+
+        memcpy(residual + out, source + lit, s - lit);
+        out += s - lit;
+        ref = put_varint(ref, s - lit);
+        ref = put_varint(ref, s - r);
+        ref = put_varint(ref, len);
+        count++;
+
+        /* continue after the match with a new window */
+        lit = s + len;
+        i = lit - 1;
+        primed = 0;
+        hash = 0;
+    }
+    memcpy(residual + out, source + lit, sourceLen - lit);
+    out += sourceLen - lit;
+
+    /* both streams are compressed with regular deflate */
+    refsSize = *destLen - DEDUP_HEADER;
+    err = compress2(dest + DEDUP_HEADER, &refsSize, refs, (uLong)(ref - refs), level);
+    if (err != Z_OK) goto done;
+    residualSize = *destLen - DEDUP_HEADER - refsSize;
+    err = compress2(dest + DEDUP_HEADER + refsSize, &residualSize, residual, out, level);
+    if (err != Z_OK) goto done;
+
+    memcpy(dest, DEDUP_MAGIC, 4);
+    put_u32(dest + 4, DEDUP_VERSION);
+    put_u64(dest + 8, sourceLen);
+    put_u64(dest + 16, count);
+    put_u64(dest + 24, (uLong)(ref - refs));
+    put_u64(dest + 32, refsSize);
+    put_u64(dest + 40, out);
+    put_u64(dest + 48, residualSize);
+    *destLen = DEDUP_HEADER + refsSize + residualSize;
+
+done:
+    free(table);
+    free(residual);
+    free(refs);
+    return err;
+}
+
+/* ===========================================================================
+ * Decompression
+ */
+
+typedef struct {
+    uLong size;
+    uLong count;
+    uLong refsRaw;
+    uLong refsSize;
+    uLong residualRaw;
+    uLong residualSize;
+} dedup_header;
+
+local int dedup_read_header(const Bytef *source, uLong sourceLen, dedup_header *h)
+{
+    if (sourceLen < DEDUP_HEADER || memcmp(source, DEDUP_MAGIC, 4) != 0 ||
+        get_u32(source + 4) != DEDUP_VERSION)
+        return 0;
+    if (!get_u64(source + 8, &h->size) || !get_u64(source + 16, &h->count) ||
+        !get_u64(source + 24, &h->refsRaw) || !get_u64(source + 32, &h->refsSize) ||
+        !get_u64(source + 40, &h->residualRaw) || !get_u64(source + 48, &h->residualSize))
+        return 0;
+    /* raw streams can't be larger than the data, compressed streams should fit the source */
+    return h->residualRaw <= h->size && h->refsRaw <= dedup_refs_bound(h->size) &&
+           h->refsSize <= sourceLen - DEDUP_HEADER &&
+           h->residualSize <= sourceLen - DEDUP_HEADER - h->refsSize;
+}
+
+int ZEXPORT uncompressDedupInfo(source, sourceLen, size, refs, residual)
+    const Bytef *source;
+    uLong sourceLen;
+    uLong *size;
+    uLong *refs;
+    uLong *residual;
+{
+    dedup_header h;
+    if (!dedup_read_header(source, sourceLen, &h)) return Z_DATA_ERROR;
+    if (size) *size = h.size;
+    if (refs) *refs = h.count;
+    if (residual) *residual = h.residualRaw;
+    return Z_OK;
+}
+
+/* Decompress a zlib stream which should produce exactly len bytes */
+local int dedup_inflate(Bytef *dest, uLong len, const Bytef *source, uLong sourceLen)
+{
+    uLongf destLen = len;
+    int err = uncompress(dest, &destLen, source, sourceLen);
+    if (err == Z_BUF_ERROR) return Z_DATA_ERROR;        /* more data than the header says */
+    if (err == Z_OK && destLen != len) return Z_DATA_ERROR;
+    return err;
+}
+
+int ZEXPORT uncompressDedup(dest, destLen, source, sourceLen)
+    Bytef *dest;
+    uLongf *destLen;
+    const Bytef *source;
+    uLong sourceLen;
+{
+    dedup_header h;
+    Bytef *refs, *residual;
+    const Bytef *ref, *refsEnd;
+    uLong out = 0, in = 0, n;
+    int err;
+
+    if (!dedup_read_header(source, sourceLen, &h)) return Z_DATA_ERROR;
+    if (*destLen < h.size) return Z_BUF_ERROR;
+
+    refs = (Bytef *)malloc(h.refsRaw ? h.refsRaw : 1);
+    residual = (Bytef *)malloc(h.residualRaw ? h.residualRaw : 1);
+    if (refs == NULL || residual == NULL) {
+        err = Z_MEM_ERROR;
+        goto done;
+    }
+    err = dedup_inflate(refs, h.refsRaw, source + DEDUP_HEADER, h.refsSize);
+    if (err != Z_OK) goto done;
+    err = dedup_inflate(residual, h.residualRaw, source + DEDUP_HEADER + h.refsSize, h.residualSize);
+    if (err != Z_OK) goto done;
+
+    err = Z_DATA_ERROR;
+    ref = refs;
+    refsEnd = refs + h.refsRaw;
+    for (n = 0; n < h.count; n++) {
+        uLong litLen, dist, len;
+        if (!get_varint(&ref, refsEnd, &litLen) || !get_varint(&ref, refsEnd, &dist) ||
+            !get_varint(&ref, refsEnd, &len))
+            goto done;
+        if (litLen > h.residualRaw - in || litLen > h.size - out) goto done;
+        memcpy(dest + out, residual + in, litLen);
+        in += litLen;
+        out += litLen;
+        if (dist == 0 || dist > out || len > h.size - out) goto done;
+        if (dist >= len) {
+            memcpy(dest + out, dest + out - dist, len);
+        } else {
+            /* overlapping copy repeats the last dist bytes */
+            Bytef *p = dest + out;
+            uLong k;
+            for (k = 0; k < len; k++) p[k] = p[k - dist];
+        }
+        out += len;
+    }
+    /* the rest of residual fills the output exactly */
+    if (ref != refsEnd || h.residualRaw - in != h.size - out) goto done;
+    memcpy(dest + out, residual + in, h.residualRaw - in);
+    *destLen = h.size;
+    err = Z_OK;
+
+done:
+    free(refs);
+    free(residual);
+    return err;
+}
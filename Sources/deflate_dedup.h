@@ -0,0 +1,71 @@
+/*
+ * Long-range deduplication pre-pass for deflate.
+ * For details and updates please visit
+ * https://github.com/gildor2/fast_zlib
+ * Licensed under the BSD license. See LICENSE.txt file in the project root for full license information.
+ */
+
+#ifndef DEFLATE_DEDUP_H
+#define DEFLATE_DEDUP_H
+
+#include "zlib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Deflate can't refer to data more than 32 KB back, so repeats in large data sets -
+ * the same DLL in several directories of a backup, copies of a file in an archive - are
+ * compressed again every time. The pre-pass finds such repeats before deflate: a 64-bit
+ * rolling hash of the last 64 bytes is computed at every position, and positions where
+ * the top bits of the hash are zero (about 1 of 64, chosen by content, so the same data
+ * gives the same positions) are stored in a large hash table. When a later position
+ * finds an earlier one in the table, the match is verified and extended in both
+ * directions. Matches of at least 128 bytes and farther than 32 KB are removed from the
+ * data and replaced by references; everything else (the residual) is compressed by
+ * regular deflate, so closer repeats are still found by the matcher.
+ *
+ * The output is a container, not a zlib stream, and it's decompressed by uncompressDedup()
+ * only. Container format: 4 bytes "FZDD", 4-byte version, 8-byte size of original data,
+ * 8-byte number of references, then the sizes of raw and compressed reference stream and
+ * raw and compressed residual, 8 bytes each. All numbers are little endian. The header is
+ * followed by the zlib stream of references and the zlib stream of the residual. Every
+ * reference is a triple of LEB128 numbers: length of residual data before it, distance
+ * back from the current output position, and length of the copy; the copy may overlap
+ * its own output, like deflate matches do.
+ *
+ * The hash table has 2^tableBits entries of uLong size, e.g. 32 MB for the default 22
+ * bits with 64-bit uLong. It's allocated for every call, and all data should be passed
+ * at once, so the pre-pass is intended for large buffers.
+ */
+
+#define Z_DEDUP_DEFAULT_BITS    22
+
+ZEXTERN int ZEXPORT compressDedup OF((Bytef *dest, uLongf *destLen,
+                                      const Bytef *source, uLong sourceLen,
+                                      int level, int tableBits));
+/* Compress source into a dedup container, level is passed to deflate, tableBits is 16..28
+ * (Z_DEDUP_DEFAULT_BITS is a good choice). Returns Z_OK, Z_BUF_ERROR when dest is too
+ * small, Z_MEM_ERROR, or Z_STREAM_ERROR for invalid parameters.
+ */
+
+ZEXTERN uLong ZEXPORT compressDedupBound OF((uLong sourceLen));
+/* Upper bound of compressDedup() output size */
+
+ZEXTERN int ZEXPORT uncompressDedup OF((Bytef *dest, uLongf *destLen,
+                                        const Bytef *source, uLong sourceLen));
+/* Decompress a container, like uncompress(). Returns Z_OK, Z_BUF_ERROR when dest is too
+ * small, Z_DATA_ERROR for damaged data, or Z_MEM_ERROR.
+ */
+
+ZEXTERN int ZEXPORT uncompressDedupInfo OF((const Bytef *source, uLong sourceLen,
+                                            uLong *size, uLong *refs, uLong *residual));
+/* Read the container header: size of original data, number of references and size of the
+ * residual passed to deflate. Any pointer could be NULL. Returns Z_OK or Z_DATA_ERROR.
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DEFLATE_DEDUP_H */
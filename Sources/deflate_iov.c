@@ -0,0 +1,115 @@
+/*
+ * Scatter/gather compression: input and output as lists of memory segments.
+ * For details and updates please visit
+ * https://github.com/gildor2/fast_zlib
+ * Licensed under the BSD license. See LICENSE.txt file in the project root for full license information.
+ */
+
+#include <string.h>
+#include "deflate.h"
+#include "deflate_iov.h"
+
+/* Largest piece of a segment passed to a single deflate() call */
+#define IOV_MAX_CHUNK   ((uInt)-1)
+
+/* When the end of the stream exactly fills the output, deflate() returns Z_OK, and
+ * Z_STREAM_END is returned by the next call only, which requires output space. The
+ * stream is complete when the last block and the trailer are written and nothing is
+ * pending.
+ */
+local int iov_finished(strm)
+    z_streamp strm;
+{
+    deflate_state *s = (deflate_state *)strm->state;
+    return s->status == FINISH_STATE && s->wrap <= 0 && s->pending == 0;
+}
+
+int ZEXPORT deflateIov(strm, dest, destCount, destLen, source, sourceCount, flush)
+    z_streamp strm;
+    const z_iovec *dest;
+    unsigned destCount;
+    size_t *destLen;
+    const z_iovec *source;
+    unsigned sourceCount;
+    int flush;
+{
+    unsigned si = 0, di = 0;            /* current segments */
+    size_t sourcePos = 0, destPos = 0;  /* position inside current segments */
+    size_t written = 0;
+    int err = Z_OK;
+
+    if (strm == Z_NULL || destLen == NULL || (dest == NULL && destCount) ||
+        (source == NULL && sourceCount))
+        return Z_STREAM_ERROR;
+
+    for (;;) {
+        uInt inChunk, outChunk;
+        int last, f;
+
+        /* skip fully processed and empty segments */
+        while (si < sourceCount && sourcePos == source[si].iov_len) {
+            si++;
+            sourcePos = 0;
+        }
+        while (di < destCount && destPos == dest[di].iov_len) {
+            di++;
+            destPos = 0;
+        }
+        last = (si == sourceCount);
+        if (last && flush == Z_NO_FLUSH) break;     /* all input consumed, nothing to flush */
+        if (di == destCount) {
+            err = (last && flush == Z_FINISH && iov_finished(strm)) ? Z_STREAM_END : Z_BUF_ERROR;
+            break;
+        }
+
+        inChunk = 0;
+        if (!last) {
+            size_t left = source[si].iov_len - sourcePos;
+            inChunk = left > IOV_MAX_CHUNK ? IOV_MAX_CHUNK : (uInt)left;
+            strm->next_in = (z_const Bytef *)source[si].iov_base + sourcePos;
+        }
+        strm->avail_in = inChunk;
+        {
+            size_t left = dest[di].iov_len - destPos;
+            outChunk = left > IOV_MAX_CHUNK ? IOV_MAX_CHUNK : (uInt)left;
+        }
+        strm->next_out = (Bytef *)dest[di].iov_base + destPos;
+        strm->avail_out = outChunk;
+
+        /* the flush is requested only when all input was passed to deflate */
+        f = last ? flush : Z_NO_FLUSH;
+        err = deflate(strm, f);
+        sourcePos += inChunk - strm->avail_in;
+        destPos += outChunk - strm->avail_out;
+        written += outChunk - strm->avail_out;
+
+        if (err == Z_STREAM_END) break;
+        if (err == Z_BUF_ERROR) err = Z_OK;         /* no progress because of empty buffer, not an error */
+        if (err != Z_OK) break;
+        /* deflate() completes the flush when it leaves some output space */
+        if (last && strm->avail_out != 0) break;
+    }
+
+    *destLen = written;
+    return err;
+}
+
+int ZEXPORT compressIov(dest, destCount, destLen, source, sourceCount, level)
+    const z_iovec *dest;
+    unsigned destCount;
+    size_t *destLen;
+    const z_iovec *source;
+    unsigned sourceCount;
+    int level;
+{
+    z_stream strm;
+    int err;
+
+    memset(&strm, 0, sizeof(strm));
+    err = deflateInit(&strm, level);
+    if (err != Z_OK) return err;
+
+    err = deflateIov(&strm, dest, destCount, destLen, source, sourceCount, Z_FINISH);
+    deflateEnd(&strm);
+    return err == Z_STREAM_END ? Z_OK : err;
+}
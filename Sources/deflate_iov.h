@@ -0,0 +1,59 @@
+/*
+ * Scatter/gather compression: input and output as lists of memory segments.
+ * For details and updates please visit
+ * https://github.com/gildor2/fast_zlib
+ * Licensed under the BSD license. See LICENSE.txt file in the project root for full license information.
+ */
+
+#ifndef DEFLATE_IOV_H
+#define DEFLATE_IOV_H
+
+#include <stddef.h>
+#include "zlib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Payloads assembled from many fragments don't need to be copied into a single
+ * buffer before compression. Segments are fed to the same deflate stream one after
+ * another, and deflate keeps them in its sliding window, so matches are found across
+ * segment boundaries exactly as for contiguous data: compressed output is the same as
+ * for the concatenation of all segments. Output is written directly to the list of
+ * output segments. Segments could be larger than 4 GB, and could be empty.
+ *
+ * z_iovec has the same layout as POSIX struct iovec, so arrays of struct iovec
+ * could be passed with a cast.
+ */
+
+typedef struct z_iovec_s {
+    void *iov_base;
+    size_t iov_len;
+} z_iovec;
+
+ZEXTERN int ZEXPORT deflateIov OF((z_streamp strm,
+                                   const z_iovec *dest, unsigned destCount, size_t *destLen,
+                                   const z_iovec *source, unsigned sourceCount,
+                                   int flush));
+/* Compress all source segments with an initialized stream, then perform "flush"
+ * the same way as deflate() does. Compressed data is written to dest segments, its
+ * size is returned in destLen. Returns Z_STREAM_END when flush was Z_FINISH and all
+ * data was written, Z_OK when the data was compressed and flushed, Z_BUF_ERROR when
+ * output segments are full. In the latter case, strm->total_in shows how much input
+ * was consumed, and compression could be continued with the rest of input and new
+ * output segments. Other errors are the same as for deflate().
+ */
+
+ZEXTERN int ZEXPORT compressIov OF((const z_iovec *dest, unsigned destCount, size_t *destLen,
+                                    const z_iovec *source, unsigned sourceCount,
+                                    int level));
+/* Equivalent of compress2() for segmented data. Returns Z_OK, Z_MEM_ERROR,
+ * Z_BUF_ERROR when output segments are too small, or Z_STREAM_ERROR when the
+ * level is invalid.
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DEFLATE_IOV_H */
@@ -0,0 +1,225 @@
+/*
+ * Pool of reusable deflate streams.
+ * For details and updates please visit
+ * https://github.com/gildor2/fast_zlib
+ * Licensed under the BSD license. See LICENSE.txt file in the project root for full license information.
+ */
+
+#include "deflate.h"
+#include "deflate_pool.h"
+
+/* These are local to deflate.c, so replicate them here */
+#define NIL 0
+#define UPDATE_HASH(s,h,c) (h = (((h) << s->hash_shift) ^ (c)) & s->hash_mask)
+
+/* Clear only touched part of head[] when the previous message used less than
+ * 1/POOL_LAZY_CLEAR of hash table size; otherwise zeroing whole table is cheaper.
+ */
+#define POOL_LAZY_CLEAR     8
+
+struct deflate_pool_s {
+    int windowBits;
+    int memLevel;
+    /* parameters of a freshly initialized stream, used to detect streams which
+     * were modified with deflateParams() or deflateTune()
+     */
+    int level;
+    int strategy;
+    uInt good_match;
+    uInt max_lazy_match;
+    int nice_match;
+    uInt max_chain_length;
+    int initialized;                    /* bool, parameters above are valid */
+    unsigned capacity;
+    unsigned count;                     /* number of idle streams */
+    z_streamp *streams;                 /* idle streams, used as a stack */
+};
+
+/* ===========================================================================
+ * Remove hash chains which could be created by the previous message. Hash is
+ * recomputed for every inserted position, so work is proportional to the data
+ * size, but not to the hash table size.
+ */
+local void pool_clear_touched(deflate_state *s, ulg used)
+{
+    Bytef *p = s->window;
+    Bytef *end = s->window + used;
+    uInt h = 0;
+
+    /* INSERT_STRING may read up to 2 bytes past the data, but never past window */
+    if (used > s->window_size - (MIN_MATCH-1)) end = s->window + s->window_size - (MIN_MATCH-1);
+    UPDATE_HASH(s, h, p[0]);
+    UPDATE_HASH(s, h, p[1]);
+    for ( ; p < end; p++) {
+        UPDATE_HASH(s, h, p[MIN_MATCH-1]);
+        s->head[h] = NIL;
+    }
+}
+
+/* ===========================================================================
+ * Equivalent of deflateReset() for a stream which is returned to the pool.
+ * Returns Z_OK when the stream could be reused.
+ */
+local int pool_reset_stream(deflate_pool *pool, z_streamp strm)
+{
+    deflate_state *s = (deflate_state *)strm->state;
+    ulg used;
+    int err;
+
+    if (s == Z_NULL) return Z_STREAM_ERROR;
+    used = (ulg)s->strstart + s->lookahead;
+
+    if (s->level != pool->level || s->strategy != pool->strategy ||
+        s->good_match != pool->good_match || s->max_lazy_match != pool->max_lazy_match ||
+        s->nice_match != pool->nice_match || s->max_chain_length != pool->max_chain_length)
+        goto full_reset;                /* parameters changed */
+
+    if (s->head_gen != Z_NULL && s->hash_gen < MAX_HASH_GEN) {
+        /* deflate.c compiled with GEN_HASH: new generation drops all hash chains */
+        s->hash_gen++;
+        s->hash_gen_base = s->hash_gen;
+    } else if (strm->total_in == used && used * POOL_LAZY_CLEAR <= s->hash_size) {
+        /* Small message, and window was never slid: total_in covers exactly window contents */
+        pool_clear_touched(s, used);
+    } else {
+        goto full_reset;
+    }
+
+    err = deflateResetKeep(strm);
+    if (err != Z_OK) return err;
+    s->gzhead = Z_NULL;
+
+    /* lm_init() without CLEAR_HASH(), configuration is already valid */
+    s->strstart = 0;
+    s->block_start = 0L;
+    s->lookahead = 0;
+    s->insert = 0;
+    s->match_length = s->prev_length = MIN_MATCH-1;
+    s->match_available = 0;
+    s->ins_h = 0;
+    s->match_work = 0;                  /* budget of MATCH_BUDGET starts again for every message */
+    return Z_OK;
+
+full_reset:
+    err = deflateReset(strm);
+    if (err == Z_OK) err = deflateParams(strm, pool->level, pool->strategy);
+    return err;
+}
+
+/* ========================================================================= */
+local void pool_free_stream(z_streamp strm)
+{
+    deflateEnd(strm);
+    free(strm);
+}
+
+/* ========================================================================= */
+deflate_pool * ZEXPORT deflatePoolCreate(int level, int windowBits, int memLevel,
+                                         int strategy, unsigned capacity)
+{
+    deflate_pool *pool = (deflate_pool *)calloc(1, sizeof(deflate_pool));
+    if (pool == Z_NULL) return Z_NULL;
+    if (capacity == 0) capacity = 1;
+    pool->streams = (z_streamp *)malloc(capacity * sizeof(z_streamp));
+    if (pool->streams == Z_NULL) {
+        free(pool);
+        return Z_NULL;
+    }
+    pool->level = level;
+    pool->windowBits = windowBits;
+    pool->memLevel = memLevel;
+    pool->strategy = strategy;
+    pool->capacity = capacity;
+    return pool;
+}
+
+/* ========================================================================= */
+void ZEXPORT deflatePoolDestroy(deflate_pool *pool)
+{
+    if (pool == Z_NULL) return;
+    while (pool->count)
+        pool_free_stream(pool->streams[--pool->count]);
+    free(pool->streams);
+    free(pool);
+}
+
+/* ========================================================================= */
+z_streamp ZEXPORT deflatePoolAcquire(deflate_pool *pool)
+{
+    z_streamp strm;
+    deflate_state *s;
+
+    if (pool->count) return pool->streams[--pool->count];
+
+    strm = (z_streamp)calloc(1, sizeof(z_stream));
+    if (strm == Z_NULL) return Z_NULL;
+    if (deflateInit2(strm, pool->level, Z_DEFLATED, pool->windowBits,
+                     pool->memLevel, pool->strategy) != Z_OK) {
+        free(strm);
+        return Z_NULL;
+    }
+    if (!pool->initialized) {
+        /* remember normalized parameters, e.g. Z_DEFAULT_COMPRESSION is level 6 */
+        s = (deflate_state *)strm->state;
+        pool->level = s->level;
+        pool->strategy = s->strategy;
+        pool->good_match = s->good_match;
+        pool->max_lazy_match = s->max_lazy_match;
+        pool->nice_match = s->nice_match;
+        pool->max_chain_length = s->max_chain_length;
+        pool->initialized = 1;
+    }
+    return strm;
+}
+
+/* ========================================================================= */
+void ZEXPORT deflatePoolRelease(deflate_pool *pool, z_streamp strm)
+{
+    if (strm == Z_NULL) return;
+    if (pool->count < pool->capacity && pool_reset_stream(pool, strm) == Z_OK) {
+        strm->next_in = Z_NULL;
+        strm->avail_in = 0;
+        strm->next_out = Z_NULL;
+        strm->avail_out = 0;
+        pool->streams[pool->count++] = strm;
+    } else {
+        pool_free_stream(strm);
+    }
+}
+
+/* ========================================================================= */
+int ZEXPORT deflatePoolCompress(deflate_pool *pool, Bytef *dest, uLongf *destLen,
+                                const Bytef *source, uLong sourceLen)
+{
+    z_streamp strm;
+    int err;
+    const uInt max = (uInt)-1;
+    uLong left;
+
+    strm = deflatePoolAcquire(pool);
+    if (strm == Z_NULL) return Z_MEM_ERROR;
+
+    /* the same loop as in compress2() */
+    left = *destLen;
+    *destLen = 0;
+    strm->next_out = dest;
+    strm->avail_out = 0;
+    strm->next_in = (z_const Bytef *)source;
+    strm->avail_in = 0;
+
+    do {
+        if (strm->avail_out == 0) {
+            strm->avail_out = left > (uLong)max ? max : (uInt)left;
+            left -= strm->avail_out;
+        }
+        if (strm->avail_in == 0) {
+            strm->avail_in = sourceLen > (uLong)max ? max : (uInt)sourceLen;
+            sourceLen -= strm->avail_in;
+        }
+        err = deflate(strm, sourceLen ? Z_NO_FLUSH : Z_FINISH);
+    } while (err == Z_OK);
+
+    *destLen = strm->total_out;
+    deflatePoolRelease(pool, strm);
+    return err == Z_STREAM_END ? Z_OK : err;
+}
@@ -0,0 +1,63 @@
+/*
+ * Pool of reusable deflate streams.
+ * For details and updates please visit
+ * https://github.com/gildor2/fast_zlib
+ * Licensed under the BSD license. See LICENSE.txt file in the project root for full license information.
+ */
+
+#ifndef DEFLATE_POOL_H
+#define DEFLATE_POOL_H
+
+#include "zlib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Compressing many small messages with deflateInit2()/deflateEnd() pairs spends
+ * most of the time in allocation and zeroing of window, prev, head and pending
+ * buffers. The pool keeps streams which were already initialized with the same
+ * parameters and recycles them with deflateReset() semantics. When the previous
+ * message was small, only head[] buckets which could be touched by it are cleared,
+ * so a 1 KB message doesn't pay for zeroing the whole hash table.
+ *
+ * The pool is not thread-safe, use one pool per thread.
+ */
+
+typedef struct deflate_pool_s deflate_pool;
+
+ZEXTERN deflate_pool * ZEXPORT deflatePoolCreate OF((int level, int windowBits,
+                                                     int memLevel, int strategy,
+                                                     unsigned capacity));
+/* Create a pool holding up to "capacity" idle streams; parameters have the same
+ * meaning as for deflateInit2(). Returns Z_NULL when out of memory.
+ */
+
+ZEXTERN void ZEXPORT deflatePoolDestroy OF((deflate_pool *pool));
+/* Free all idle streams and the pool itself. Streams which are still acquired
+ * should be released before this call.
+ */
+
+ZEXTERN z_streamp ZEXPORT deflatePoolAcquire OF((deflate_pool *pool));
+/* Get a stream ready for compression of a new message, as if deflateInit2() was
+ * just called for it. next_in, next_out and friends should be set by the caller.
+ * Returns Z_NULL when a new stream is required and it couldn't be created.
+ */
+
+ZEXTERN void ZEXPORT deflatePoolRelease OF((deflate_pool *pool, z_streamp strm));
+/* Return the stream to the pool. Stream could be in any state, it is not required
+ * to finish compression with Z_FINISH.
+ */
+
+ZEXTERN int ZEXPORT deflatePoolCompress OF((deflate_pool *pool,
+                                            Bytef *dest, uLongf *destLen,
+                                            const Bytef *source, uLong sourceLen));
+/* Equivalent of compress2() which uses a pooled stream. Return codes are the
+ * same as for compress2().
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DEFLATE_POOL_H */
@@ -0,0 +1,163 @@
+/*
+ * Rsyncable compression: deflate stream reset at content-defined points.
+ * For details and updates please visit
+ * https://github.com/gildor2/fast_zlib
+ * Licensed under the BSD license. See LICENSE.txt file in the project root for full license information.
+ */
+
+#include <string.h>
+#include "deflate.h"
+#include "deflate_rsync.h"
+
+/* Output of a single boundary: end of the current block, empty stored block of
+ * Z_FULL_FLUSH and a header of the next block, with some margin.
+ */
+#define RSYNC_BOUNDARY_BYTES    16
+
+int ZEXPORT deflateRsyncInit(rs, chunkBits)
+    z_rsync *rs;
+    int chunkBits;
+{
+    uInt seed = 0x2545F491;
+    int i;
+
+    if (rs == NULL || chunkBits < 8 || chunkBits > 24) return Z_STREAM_ERROR;
+    memset(rs, 0, sizeof(*rs));
+    /* top bits of the hash depend on the most of 32 last bytes */
+    rs->mask = ~(uInt)0 << (32 - chunkBits);
+    rs->minChunk = 1UL << (chunkBits - 2);
+    rs->maxChunk = 1UL << (chunkBits + 2);
+    /* fixed sequence, so the same data is cut at the same places by every build */
+    for (i = 0; i < 256; i++) {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        rs->gear[i] = seed;
+    }
+    return Z_OK;
+}
+
+/* Hash input until the next boundary, returns the number of scanned bytes */
+local uInt rsync_scan(rs, buf, len)
+    z_rsync *rs;
+    const Bytef *buf;
+    uInt len;
+{
+    uInt hash = rs->hash;
+    uLong chunk = rs->chunk;
+    uInt i;
+
+    for (i = 0; i < len; i++) {
+        hash = (hash << 1) + rs->gear[buf[i]];
+        if (++chunk >= rs->minChunk && ((hash & rs->mask) == 0 || chunk >= rs->maxChunk)) {
+            rs->cut = 1;
+            chunk = 0;
+            i++;
+            break;
+        }
+    }
+    rs->hash = hash;
+    rs->chunk = chunk;
+    return i;
+}
+
+/* Z_FULL_FLUSH has written its marker and reset deflate to the start of the window, only
+ * pending output could remain. deflate() doesn't tell this when the output buffer is full,
+ * and calling it with Z_FULL_FLUSH again would add another flush marker, so the output
+ * would depend on buffer sizes.
+ */
+local int rsync_reset_done(strm)
+    z_streamp strm;
+{
+    deflate_state *s = (deflate_state *)strm->state;
+    return s->lookahead == 0 && s->strstart == 0;
+}
+
+int ZEXPORT deflateRsync(strm, rs, flush)
+    z_streamp strm;
+    z_rsync *rs;
+    int flush;
+{
+    int err, f;
+
+    if (strm == Z_NULL || rs == NULL) return Z_STREAM_ERROR;
+
+    for (;;) {
+        uInt avail = strm->avail_in, fed;
+
+        /* continue scanning when more input was given after the previous call */
+        if (!rs->cut && rs->ahead < avail)
+            rs->ahead += rsync_scan(rs, strm->next_in + rs->ahead, avail - rs->ahead);
+
+        /* deflate sees input up to the boundary only */
+        strm->avail_in = rs->ahead;
+        if (!rs->cut)
+            f = flush;
+        else if (rs->ahead == 0 && rsync_reset_done(strm))
+            f = Z_NO_FLUSH;             /* write out the rest of the flush marker */
+        else
+            f = Z_FULL_FLUSH;
+        err = deflate(strm, f);
+        fed = rs->ahead - strm->avail_in;
+        rs->ahead -= fed;
+        strm->avail_in = avail - fed;
+
+        if (!rs->cut || (err != Z_OK && err != Z_BUF_ERROR)) break;
+        if (rs->ahead || !rsync_reset_done(strm) || ((deflate_state *)strm->state)->pending) return Z_OK;
+        rs->cut = 0;
+        rs->boundaries++;
+        /* deflate() would return Z_BUF_ERROR without anything to do, but this call has
+         * made progress
+         */
+        if (strm->avail_out == 0 || (strm->avail_in == 0 && flush == Z_NO_FLUSH)) return Z_OK;
+    }
+    return err;
+}
+
+uLong ZEXPORT compressRsyncBound(sourceLen, chunkBits)
+    uLong sourceLen;
+    int chunkBits;
+{
+    if (chunkBits < 8) chunkBits = 8;
+    return compressBound(sourceLen) + ((sourceLen >> (chunkBits - 2)) + 1) * RSYNC_BOUNDARY_BYTES;
+}
+
+int ZEXPORT compressRsync(dest, destLen, source, sourceLen, level, chunkBits)
+    Bytef *dest;
+    uLongf *destLen;
+    const Bytef *source;
+    uLong sourceLen;
+    int level;
+    int chunkBits;
+{
+    z_stream strm;
+    z_rsync rs;
+    uLong left = *destLen;
+    int err;
+
+    err = deflateRsyncInit(&rs, chunkBits);
+    if (err != Z_OK) return err;
+    memset(&strm, 0, sizeof(strm));
+    err = deflateInit(&strm, level);
+    if (err != Z_OK) return err;
+
+    /* pass data by pieces, because avail_in and avail_out are 32-bit */
+    strm.next_out = dest;
+    strm.next_in = (z_const Bytef *)source;
+    *destLen = 0;
+    do {
+        if (strm.avail_out == 0) {
+            strm.avail_out = left > (uInt)-1 ? (uInt)-1 : (uInt)left;
+            left -= strm.avail_out;
+        }
+        if (strm.avail_in == 0) {
+            strm.avail_in = sourceLen > (uInt)-1 ? (uInt)-1 : (uInt)sourceLen;
+            sourceLen -= strm.avail_in;
+        }
+        err = deflateRsync(&strm, &rs, sourceLen ? Z_NO_FLUSH : Z_FINISH);
+    } while (err == Z_OK && (strm.avail_out != 0 || left != 0));
+
+    *destLen = strm.total_out;
+    deflateEnd(&strm);
+    return err == Z_STREAM_END ? Z_OK : err == Z_OK ? Z_BUF_ERROR : err;
+}
@@ -0,0 +1,79 @@
+/*
+ * Rsyncable compression: deflate stream reset at content-defined points.
+ * For details and updates please visit
+ * https://github.com/gildor2/fast_zlib
+ * Licensed under the BSD license. See LICENSE.txt file in the project root for full license information.
+ */
+
+#ifndef DEFLATE_RSYNC_H
+#define DEFLATE_RSYNC_H
+
+#include "zlib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* A change in the input of a regular deflate stream changes all compressed data after it,
+ * because every following block refers to the changed history and has different Huffman
+ * codes. rsync and other delta tools can't find anything in common between old and new
+ * versions of such file. Rsyncable mode cuts input into chunks with a rolling hash: a
+ * boundary is placed where the hash of the last 32 input bytes has its top chunkBits bits
+ * equal to zero, so boundaries depend on the data near them only, and they're found at
+ * the same places after an edit. At every boundary the stream is flushed with Z_FULL_FLUSH,
+ * which ends the current deflate block and resets history, so compressed data between
+ * boundaries not affected by the edit stays the same. Output is a regular zlib or gzip
+ * stream, decompressed by any inflater.
+ *
+ * Every reset clears the hash table of deflate. It's cheap when deflate.c is compiled with
+ * GEN_HASH (see README.md). Compression ratio is reduced, because matches can't cross
+ * boundaries; average chunk size of 2^chunkBits bytes sets the balance between ratio and
+ * the amount of data changed after an edit. Chunks are not shorter than 1/4 of average
+ * and not longer than 4 averages.
+ */
+
+#define Z_RSYNC_DEFAULT_BITS    13      /* 8 KB chunks */
+
+typedef struct z_rsync_s {
+    uInt hash;              /* rolling hash of the last 32 bytes */
+    uInt mask;              /* boundary when (hash & mask) == 0 */
+    uLong chunk;            /* bytes of the current chunk */
+    uLong minChunk;
+    uLong maxChunk;
+    uInt ahead;             /* bytes of input already scanned, but not consumed by deflate */
+    int cut;                /* boundary is at the end of scanned input */
+    uLong boundaries;       /* number of flushed boundaries, for statistics */
+    uInt gear[256];         /* random value for every byte */
+} z_rsync;
+
+ZEXTERN int ZEXPORT deflateRsyncInit OF((z_rsync *rs, int chunkBits));
+/* Initialize chunking state for a new stream, chunkBits is 8..24 (Z_RSYNC_DEFAULT_BITS
+ * is a good choice). Returns Z_OK or Z_STREAM_ERROR when chunkBits is out of range. The
+ * state doesn't allocate memory. For a reset deflate stream it should be initialized again.
+ */
+
+ZEXTERN int ZEXPORT deflateRsync OF((z_streamp strm, z_rsync *rs, int flush));
+/* Replacement of deflate() for rsyncable streams, with the same arguments, return codes
+ * and rules of buffer handling. Input consumed by deflate is cut at boundaries, and every
+ * boundary is followed by Z_FULL_FLUSH. When the output buffer is full in the middle of
+ * such flush, the function should be called again with more output space, as usual.
+ * Unlike plain Z_FULL_FLUSH, this never writes repeated flush markers, so the output
+ * doesn't depend on sizes of input and output buffers.
+ */
+
+ZEXTERN int ZEXPORT compressRsync OF((Bytef *dest, uLongf *destLen,
+                                      const Bytef *source, uLong sourceLen,
+                                      int level, int chunkBits));
+/* Equivalent of compress2() producing rsyncable zlib stream. Every boundary adds a few
+ * bytes, so the output could be slightly larger than compressBound(sourceLen), use
+ * compressRsyncBound() for the destination size.
+ */
+
+ZEXTERN uLong ZEXPORT compressRsyncBound OF((uLong sourceLen, int chunkBits));
+/* Upper bound of compressRsync() output size */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DEFLATE_RSYNC_H */
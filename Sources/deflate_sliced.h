@@ -0,0 +1,228 @@
+/*
+ * Time-sliced deflate wrapper for cooperative schedulers and C++20 coroutines.
+ * For details and updates please visit
+ * https://github.com/gildor2/fast_zlib
+ * Licensed under the BSD license. See LICENSE.txt file in the project root for full license information.
+ */
+
+#ifndef DEFLATE_SLICED_H
+#define DEFLATE_SLICED_H
+
+/* A single deflate() call with large input could run for a long time at high compression levels,
+ * blocking the calling thread. SlicedDeflate compresses data with bounded slices: each Step() call
+ * processes at most SliceBudget::maxInput bytes of input, or returns after SliceBudget::maxMicroseconds,
+ * whichever comes first. Time is checked between deflate() calls, each of them receives at most
+ * SLICED_DEFLATE_CHUNK bytes, so the time limit is soft.
+ *
+ * Without coroutines:
+ *
+ *     SlicedDeflate d;
+ *     d.Init(9);
+ *     d.Begin(data, size, &output);
+ *     while (!d.Step(budget)) { ... do other work ... }
+ *     int result = d.Result();
+ *
+ * With C++20 coroutines, Slice() returns an awaitable which runs one step and, if the work is not
+ * finished yet, suspends the coroutine and passes its handle to "schedule" callable, which should
+ * resume it later (e.g. post it to the reactor queue):
+ *
+ *     d.Begin(data, size, &output);
+ *     while (co_await d.Slice(budget, [&](std::coroutine_handle<> h) { reactor.post(h); })) {}
+ *
+ * Compressed data is appended to a std::vector, the result is the same as for a single deflate() call
+ * with the whole input and Z_FINISH. The header requires C++11, Slice() is available with C++20.
+ */
+
+#include <chrono>
+#include <vector>
+#include <string.h>
+
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+#include <coroutine>
+#define SLICED_DEFLATE_COROUTINES 1
+#endif
+
+#include "zlib.h"
+
+// Size of the input passed to one deflate() call, limits granularity of time checks
+#define SLICED_DEFLATE_CHUNK	(16<<10)
+
+struct SliceBudget
+{
+	size_t maxInput;			// 0 = unlimited
+	unsigned maxMicroseconds;	// 0 = unlimited
+
+	SliceBudget(size_t inMaxInput = 256<<10, unsigned inMaxMicroseconds = 1000)
+	:	maxInput(inMaxInput)
+	,	maxMicroseconds(inMaxMicroseconds)
+	{}
+};
+
+class SlicedDeflate
+{
+public:
+	SlicedDeflate()
+	:	initialized(false)
+	,	finished(true)
+	,	result(Z_OK)
+	,	output(NULL)
+	{
+		memset(&strm, 0, sizeof(strm));
+	}
+
+	~SlicedDeflate()
+	{
+		if (initialized) deflateEnd(&strm);
+	}
+
+	// Parameters are the same as for deflateInit2(), default values match compress2()
+	int Init(int level, int windowBits = MAX_WBITS, int memLevel = 8, int strategy = Z_DEFAULT_STRATEGY)
+	{
+		if (initialized) deflateEnd(&strm);
+		memset(&strm, 0, sizeof(strm));
+		result = deflateInit2(&strm, level, Z_DEFLATED, windowBits, memLevel, strategy);
+		initialized = (result == Z_OK);
+		return result;
+	}
+
+	// Start compression of a new message. Data should stay valid until compression is finished.
+	// The stream is reused with deflateReset(), so it's cheap to compress many messages.
+	void Begin(const void* data, size_t size, std::vector<unsigned char>* inOutput)
+	{
+		if (!initialized)
+		{
+			finished = true;
+			result = Z_STREAM_ERROR;
+			return;
+		}
+		if (strm.total_in || strm.total_out) deflateReset(&strm);
+		input = (const Bytef*)data;
+		inputLeft = size;
+		output = inOutput;
+		finished = false;
+		result = Z_OK;
+	}
+
+	// Perform a slice of work, returns true when compression is finished
+	bool Step(const SliceBudget& budget = SliceBudget())
+	{
+		if (finished) return true;
+
+		typedef std::chrono::steady_clock Clock;
+		Clock::time_point deadline;
+		if (budget.maxMicroseconds)
+			deadline = Clock::now() + std::chrono::microseconds(budget.maxMicroseconds);
+		size_t sliceLeft = budget.maxInput ? budget.maxInput : (size_t)-1;
+
+		while (true)
+		{
+			// pass a limited piece of input to deflate()
+			size_t chunk = SLICED_DEFLATE_CHUNK;
+			if (chunk > inputLeft) chunk = inputLeft;
+			if (chunk > sliceLeft) chunk = sliceLeft;
+			strm.next_in = (Bytef*)input;
+			strm.avail_in = (uInt)chunk;
+			int flush = (chunk == inputLeft) ? Z_FINISH : Z_NO_FLUSH;
+
+			// drain the output produced for this piece of input
+			int err;
+			do
+			{
+				size_t pos = output->size();
+				size_t space = deflateBound(&strm, strm.avail_in) + 64;
+				output->resize(pos + space);
+				strm.next_out = &(*output)[pos];
+				strm.avail_out = (uInt)space;
+				err = deflate(&strm, flush);
+				output->resize(pos + (space - strm.avail_out));
+			} while (err == Z_OK && strm.avail_out == 0);
+
+			size_t consumed = chunk - strm.avail_in;
+			input += consumed;
+			inputLeft -= consumed;
+			sliceLeft -= consumed;
+
+			if (err == Z_STREAM_END)
+			{
+				finished = true;
+				result = Z_OK;
+				return true;
+			}
+			if (err != Z_OK && err != Z_BUF_ERROR)
+			{
+				finished = true;
+				result = err;
+				return true;
+			}
+			if (sliceLeft == 0) break;
+			if (budget.maxMicroseconds && Clock::now() >= deadline) break;
+		}
+		return false;
+	}
+
+	bool Finished() const
+	{
+		return finished;
+	}
+
+	// Z_OK when compression has succeeded, otherwise zlib error code
+	int Result() const
+	{
+		return result;
+	}
+
+	z_streamp Stream()
+	{
+		return &strm;
+	}
+
+#if SLICED_DEFLATE_COROUTINES
+	// Awaitable returned by Slice(): "co_await" evaluates to true while there's more work to do
+	template<typename Scheduler>
+	struct SliceAwaitable
+	{
+		SlicedDeflate* owner;
+		SliceBudget budget;
+		Scheduler schedule;
+		bool done;
+
+		bool await_ready()
+		{
+			// do the work right in the awaiting coroutine, then suspend only if something remains
+			done = owner->Step(budget);
+			return done;
+		}
+		void await_suspend(std::coroutine_handle<> handle)
+		{
+			schedule(handle);
+		}
+		bool await_resume() const
+		{
+			return !done;
+		}
+	};
+
+	template<typename Scheduler>
+	SliceAwaitable<Scheduler> Slice(const SliceBudget& budget, Scheduler schedule)
+	{
+		SliceAwaitable<Scheduler> a = { this, budget, schedule, false };
+		return a;
+	}
+#endif // SLICED_DEFLATE_COROUTINES
+
+protected:
+	z_stream strm;
+	bool initialized;
+	bool finished;
+	int result;
+	const Bytef* input;
+	size_t inputLeft;
+	std::vector<unsigned char>* output;
+
+private:
+	// z_stream contains pointers to itself inside the deflate state
+	SlicedDeflate(const SlicedDeflate&);
+	SlicedDeflate& operator=(const SlicedDeflate&);
+};
+
+#endif // DEFLATE_SLICED_H
@@ -0,0 +1,549 @@
+/*
+ * Random access to existing gzip files with an index of inflate checkpoints.
+ * For details and updates please visit
+ * https://github.com/gildor2/fast_zlib
+ * Licensed under the BSD license. See LICENSE.txt file in the project root for full license information.
+ */
+
+#if !defined(_WIN32) && !defined(_FILE_OFFSET_BITS)
+#define _FILE_OFFSET_BITS 64
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gzindex.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#define FSEEK64(f, pos)     _fseeki64(f, pos, SEEK_SET)
+#else
+#include <pthread.h>
+#define FSEEK64(f, pos)     fseeko(f, (off_t)(pos), SEEK_SET)
+#endif
+
+/* Size of compressed data buffer */
+#define GZ_INDEX_CHUNK      (1 << 16)
+/* Size of inflate window */
+#define GZ_INDEX_WINSIZE    32768
+
+#define GZ_INDEX_MAGIC      "FZIX"
+#define GZ_INDEX_VERSION    1
+#define GZ_INDEX_HEADER     32          /* magic, version, span, size, count */
+#define GZ_INDEX_POINT      25          /* out, in, bits, wsize, csize */
+
+#ifndef local
+#define local static
+#endif
+
+typedef struct {
+    long long out;                      /* offset in uncompressed data */
+    long long in;                       /* offset of the first complete byte of the block */
+    int bits;                           /* number of bits of the block in the byte before "in" */
+    unsigned wsize;                     /* window size, less than 32K near the start of data */
+    unsigned csize;
+    unsigned char *window;              /* compressed window */
+} gz_index_point;
+
+struct gz_index_s {
+    long long span;
+    long long size;
+    long long count;
+    long long capacity;
+    gz_index_point *points;
+};
+
+/* ===========================================================================
+ * Index
+ */
+
+local void put_u32(unsigned char *p, unsigned v)
+{
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+    p[2] = (unsigned char)(v >> 16);
+    p[3] = (unsigned char)(v >> 24);
+}
+
+local void put_u64(unsigned char *p, long long v)
+{
+    put_u32(p, (unsigned)v);
+    put_u32(p + 4, (unsigned)((unsigned long long)v >> 32));
+}
+
+local unsigned get_u32(const unsigned char *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned)p[3] << 24);
+}
+
+local long long get_u64(const unsigned char *p)
+{
+    return (long long)(get_u32(p) | ((unsigned long long)get_u32(p + 4) << 32));
+}
+
+local gzIndex gz_index_alloc(long long span)
+{
+    gzIndex index = (gzIndex)calloc(1, sizeof(*index));
+    if (index != NULL) index->span = span;
+    return index;
+}
+
+/* Append a checkpoint, window is the last wsize bytes of uncompressed data. Returns 0
+ * when out of memory.
+ */
+local int gz_index_add(gzIndex index, long long out, long long in, int bits,
+                       const unsigned char *window, unsigned wsize)
+{
+    gz_index_point *p;
+    uLong csize = compressBound(wsize);
+
+    if (index->count == index->capacity) {
+        long long capacity = index->capacity ? index->capacity * 2 : 64;
+        p = (gz_index_point *)realloc(index->points, (size_t)capacity * sizeof(gz_index_point));
+        if (p == NULL) return 0;
+        index->points = p;
+        index->capacity = capacity;
+    }
+    p = &index->points[index->count];
+    p->out = out;
+    p->in = in;
+    p->bits = bits;
+    p->wsize = wsize;
+    p->window = (unsigned char *)malloc(csize);
+    if (p->window == NULL) return 0;
+    if (compress2(p->window, &csize, window, wsize, Z_DEFAULT_COMPRESSION) != Z_OK) {
+        free(p->window);
+        return 0;
+    }
+    p->csize = (unsigned)csize;
+    index->count++;
+    return 1;
+}
+
+/* Index of the last checkpoint at or before offset */
+local long long gz_index_find(gzIndex index, long long offset)
+{
+    long long lo = 0, hi = index->count - 1;
+    while (lo < hi) {
+        long long mid = (lo + hi + 1) / 2;
+        if (index->points[mid].out <= offset) lo = mid;
+        else hi = mid - 1;
+    }
+    return lo;
+}
+
+void ZEXPORT gzIndexFree(index)
+    gzIndex index;
+{
+    long long i;
+    if (index == NULL) return;
+    for (i = 0; i < index->count; i++)
+        free(index->points[i].window);
+    free(index->points);
+    free(index);
+}
+
+long long ZEXPORT gzIndexSize(index)
+    gzIndex index;
+{
+    return index ? index->size : -1;
+}
+
+long long ZEXPORT gzIndexPoints(index)
+    gzIndex index;
+{
+    return index ? index->count : -1;
+}
+
+/* ===========================================================================
+ * Building the index, the same way as zran.c does
+ */
+
+int ZEXPORT gzIndexBuild(path, span, index)
+    const char *path;
+    long long span;
+    gzIndex *index;
+{
+    z_stream strm;
+    FILE *file;
+    gzIndex idx;
+    unsigned char *input, *window, *linear;
+    long long totin = 0, totout = 0, last = 0;
+    int ret;
+
+    *index = NULL;
+    if (span <= 0) return Z_STREAM_ERROR;
+    file = fopen(path, "rb");
+    if (file == NULL) return Z_ERRNO;
+    idx = gz_index_alloc(span);
+    input = (unsigned char *)malloc(GZ_INDEX_CHUNK);
+    /* output goes to the circular window, "linear" is the window in order for checkpoints */
+    window = (unsigned char *)malloc(GZ_INDEX_WINSIZE * 2);
+    linear = window + GZ_INDEX_WINSIZE;
+    memset(&strm, 0, sizeof(strm));
+    if (idx == NULL || input == NULL || window == NULL) {
+        ret = Z_MEM_ERROR;
+        goto done;
+    }
+    /* 47 = automatic detection of gzip or zlib header */
+    ret = inflateInit2(&strm, 47);
+    if (ret != Z_OK) goto done;
+
+    strm.avail_out = 0;
+    do {
+        strm.avail_in = (uInt)fread(input, 1, GZ_INDEX_CHUNK, file);
+        if (ferror(file)) {
+            ret = Z_ERRNO;
+            break;
+        }
+        if (strm.avail_in == 0) {
+            ret = Z_DATA_ERROR;         /* truncated file */
+            break;
+        }
+        strm.next_in = input;
+
+        do {
+            if (strm.avail_out == 0) {
+                strm.avail_out = GZ_INDEX_WINSIZE;
+                strm.next_out = window;
+            }
+            /* Z_BLOCK stops inflate after the stream header and at the end of every block */
+            totin += strm.avail_in;
+            totout += strm.avail_out;
+            ret = inflate(&strm, Z_BLOCK);
+            totin -= strm.avail_in;
+            totout -= strm.avail_out;
+            if (ret == Z_NEED_DICT) ret = Z_DATA_ERROR;
+            if (ret == Z_MEM_ERROR || ret == Z_DATA_ERROR) break;
+            if (ret == Z_STREAM_END) break;
+
+            /* between the header and the first block, or between blocks (not after the
+             * last one): add a checkpoint when enough data was decompressed since the
+             * previous one
+             */
+            if ((strm.data_type & 128) && !(strm.data_type & 64) &&
+                (idx->count == 0 || totout - last > span)) {
+                unsigned left = strm.avail_out;
+                unsigned wsize = totout < GZ_INDEX_WINSIZE ? (unsigned)totout : GZ_INDEX_WINSIZE;
+                if (left)
+                    memcpy(linear, window + GZ_INDEX_WINSIZE - left, left);
+                if (left < GZ_INDEX_WINSIZE)
+                    memcpy(linear + left, window, GZ_INDEX_WINSIZE - left);
+                if (!gz_index_add(idx, totout, totin, strm.data_type & 7,
+                                  linear + GZ_INDEX_WINSIZE - wsize, wsize)) {
+                    ret = Z_MEM_ERROR;
+                    break;
+                }
+                last = totout;
+            }
+        } while (strm.avail_in != 0);
+    } while (ret == Z_OK || ret == Z_BUF_ERROR);
+
+    inflateEnd(&strm);
+    if (ret == Z_STREAM_END)
+        ret = idx->count ? Z_OK : Z_DATA_ERROR;
+    idx->size = totout;
+
+done:
+    fclose(file);
+    free(input);
+    free(window);
+    if (ret == Z_OK)
+        *index = idx;
+    else
+        gzIndexFree(idx);
+    return ret;
+}
+
+/* ===========================================================================
+ * Saving and loading
+ */
+
+int ZEXPORT gzIndexSave(index, path)
+    gzIndex index;
+    const char *path;
+{
+    unsigned char buf[GZ_INDEX_HEADER];
+    FILE *file;
+    long long i;
+    int ok;
+
+    if (index == NULL) return Z_STREAM_ERROR;
+    file = fopen(path, "wb");
+    if (file == NULL) return Z_ERRNO;
+
+    memcpy(buf, GZ_INDEX_MAGIC, 4);
+    put_u32(buf + 4, GZ_INDEX_VERSION);
+    put_u64(buf + 8, index->span);
+    put_u64(buf + 16, index->size);
+    put_u64(buf + 24, index->count);
+    ok = fwrite(buf, GZ_INDEX_HEADER, 1, file) == 1;
+    for (i = 0; ok && i < index->count; i++) {
+        const gz_index_point *p = &index->points[i];
+        put_u64(buf, p->out);
+        put_u64(buf + 8, p->in);
+        buf[16] = (unsigned char)p->bits;
+        put_u32(buf + 17, p->wsize);
+        put_u32(buf + 21, p->csize);
+        ok = fwrite(buf, GZ_INDEX_POINT, 1, file) == 1 &&
+             (p->csize == 0 || fwrite(p->window, p->csize, 1, file) == 1);
+    }
+    if (fclose(file) != 0) ok = 0;
+    return ok ? Z_OK : Z_ERRNO;
+}
+
+int ZEXPORT gzIndexLoad(path, index)
+    const char *path;
+    gzIndex *index;
+{
+    unsigned char buf[GZ_INDEX_HEADER];
+    FILE *file;
+    gzIndex idx = NULL;
+    long long count, i;
+    int ret = Z_DATA_ERROR;
+
+    *index = NULL;
+    file = fopen(path, "rb");
+    if (file == NULL) return Z_ERRNO;
+
+    if (fread(buf, GZ_INDEX_HEADER, 1, file) != 1) goto done;
+    if (memcmp(buf, GZ_INDEX_MAGIC, 4) != 0 || get_u32(buf + 4) != GZ_INDEX_VERSION) goto done;
+    count = get_u64(buf + 24);
+    if (count < 1 || (unsigned long long)count > ((size_t)-1) / sizeof(gz_index_point)) goto done;
+
+    idx = gz_index_alloc(get_u64(buf + 8));
+    if (idx == NULL) {
+        ret = Z_MEM_ERROR;
+        goto done;
+    }
+    idx->size = get_u64(buf + 16);
+    idx->points = (gz_index_point *)malloc((size_t)count * sizeof(gz_index_point));
+    if (idx->points == NULL) {
+        ret = Z_MEM_ERROR;
+        goto done;
+    }
+    idx->capacity = count;
+
+    for (i = 0; i < count; i++) {
+        gz_index_point *p = &idx->points[i];
+        if (fread(buf, GZ_INDEX_POINT, 1, file) != 1) goto done;
+        p->out = get_u64(buf);
+        p->in = get_u64(buf + 8);
+        p->bits = buf[16];
+        p->wsize = get_u32(buf + 17);
+        p->csize = get_u32(buf + 21);
+        /* checkpoints are in increasing order, windows are not larger than 32K */
+        if (p->bits > 7 || p->wsize > GZ_INDEX_WINSIZE || p->csize > compressBound(GZ_INDEX_WINSIZE) ||
+            p->out < 0 || p->out > idx->size || p->in < 1 ||
+            (i == 0 ? p->out != 0 : (p->out <= p[-1].out || p->in <= p[-1].in)))
+            goto done;
+        p->window = (unsigned char *)malloc(p->csize ? p->csize : 1);
+        if (p->window == NULL) {
+            ret = Z_MEM_ERROR;
+            goto done;
+        }
+        idx->count++;
+        if (p->csize && fread(p->window, p->csize, 1, file) != 1) goto done;
+    }
+    ret = Z_OK;
+
+done:
+    fclose(file);
+    if (ret == Z_OK)
+        *index = idx;
+    else
+        gzIndexFree(idx);
+    return ret;
+}
+
+/* ===========================================================================
+ * Reading
+ */
+
+/* Part of a read performed by one thread: segments between checkpoints with numbers
+ * first, first + stride, first + 2 * stride etc.
+ */
+typedef struct {
+    gzIndex index;
+    const char *path;
+    long long offset;                   /* range of the whole read */
+    long long len;
+    unsigned char *buf;
+    long long point;                    /* checkpoint of the first segment of the read */
+    long long segments;
+    long long first;
+    long long stride;
+    int error;
+#ifdef _WIN32
+    HANDLE thread;
+#else
+    pthread_t thread;
+#endif
+    int started;
+} gz_index_worker;
+
+/* Decompress len bytes into out, returns the number of bytes, less at the end of stream,
+ * or -1 in case of error
+ */
+local long long gz_index_inflate(z_streamp strm, FILE *file, unsigned char *input,
+                                 unsigned char *out, long long len)
+{
+    long long done = 0;
+    int ret = Z_OK;
+
+    while (done < len && ret != Z_STREAM_END) {
+        long long left = len - done;
+        strm->next_out = out + done;
+        strm->avail_out = left > (1 << 30) ? (1 << 30) : (uInt)left;
+        if (strm->avail_in == 0) {
+            strm->next_in = input;
+            strm->avail_in = (uInt)fread(input, 1, GZ_INDEX_CHUNK, file);
+            if (strm->avail_in == 0) return -1;
+        }
+        ret = inflate(strm, Z_NO_FLUSH);
+        if (ret != Z_OK && ret != Z_STREAM_END) return -1;
+        done = strm->next_out - out;
+    }
+    return done;
+}
+
+/* Decompress len bytes at offset starting from the checkpoint, returns 0 in case of error */
+local int gz_index_extract(z_streamp strm, FILE *file, const gz_index_point *p,
+                           unsigned char *input, unsigned char *window,
+                           long long offset, unsigned char *out, long long len)
+{
+    long long skip = offset - p->out;
+
+    if (inflateReset(strm) != Z_OK) return 0;
+    strm->avail_in = 0;
+    if (FSEEK64(file, p->in - (p->bits ? 1 : 0)) != 0) return 0;
+    if (p->bits) {
+        /* the block starts in the middle of a byte */
+        int ch = getc(file);
+        if (ch == EOF || inflatePrime(strm, p->bits, ch >> (8 - p->bits)) != Z_OK) return 0;
+    }
+    if (p->wsize) {
+        uLongf wsize = GZ_INDEX_WINSIZE;
+        if (uncompress(window, &wsize, p->window, p->csize) != Z_OK || wsize != p->wsize ||
+            inflateSetDictionary(strm, window, p->wsize) != Z_OK)
+            return 0;
+    }
+
+    /* skip data between the checkpoint and offset */
+    while (skip > 0) {
+        long long n = skip < GZ_INDEX_WINSIZE ? skip : GZ_INDEX_WINSIZE;
+        if (gz_index_inflate(strm, file, input, window, n) != n) return 0;
+        skip -= n;
+    }
+    return gz_index_inflate(strm, file, input, out, len) == len;
+}
+
+local void gz_index_work(gz_index_worker *w)
+{
+    gzIndex index = w->index;
+    z_stream strm;
+    FILE *file;
+    unsigned char *input;
+    long long s;
+
+    input = (unsigned char *)malloc(GZ_INDEX_CHUNK + GZ_INDEX_WINSIZE);
+    file = fopen(w->path, "rb");
+    memset(&strm, 0, sizeof(strm));
+    if (input == NULL || file == NULL || inflateInit2(&strm, -MAX_WBITS) != Z_OK) {
+        w->error = 1;
+        goto done;
+    }
+
+    for (s = w->first; s < w->segments && !w->error; s += w->stride) {
+        long long point = w->point + s;
+        const gz_index_point *p = &index->points[point];
+        long long start = p->out > w->offset ? p->out : w->offset;
+        long long end = point + 1 < index->count ? index->points[point + 1].out : index->size;
+        if (end > w->offset + w->len) end = w->offset + w->len;
+        if (!gz_index_extract(&strm, file, p, input, input + GZ_INDEX_CHUNK, start,
+                              w->buf + (start - w->offset), end - start))
+            w->error = 1;
+    }
+    inflateEnd(&strm);
+
+done:
+    if (file != NULL) fclose(file);
+    free(input);
+}
+
+#ifdef _WIN32
+local DWORD WINAPI gz_index_thread_proc(LPVOID param)
+#else
+local void *gz_index_thread_proc(void *param)
+#endif
+{
+    gz_index_work((gz_index_worker *)param);
+    return 0;
+}
+
+long long ZEXPORT gzIndexRead(index, path, offset, buf, len, numThreads)
+    gzIndex index;
+    const char *path;
+    long long offset;
+    voidp buf;
+    long long len;
+    unsigned numThreads;
+{
+    gz_index_worker *workers;
+    long long point, segments;
+    unsigned i, count;
+    int error = 0;
+
+    if (index == NULL || offset < 0 || len < 0) return -1;
+    if (offset >= index->size || len == 0) return 0;
+    if (len > index->size - offset) len = index->size - offset;
+
+    point = gz_index_find(index, offset);
+    segments = gz_index_find(index, offset + len - 1) - point + 1;
+    count = segments - 1 < numThreads ? (unsigned)segments : numThreads + 1;
+
+    workers = (gz_index_worker *)calloc(count, sizeof(gz_index_worker));
+    if (workers == NULL) return -1;
+    for (i = 0; i < count; i++) {
+        gz_index_worker *w = &workers[i];
+        w->index = index;
+        w->path = path;
+        w->offset = offset;
+        w->len = len;
+        w->buf = (unsigned char *)buf;
+        w->point = point;
+        w->segments = segments;
+        w->first = i;
+        w->stride = count;
+    }
+
+    /* worker 0 runs in the calling thread, as well as workers which couldn't be started */
+    for (i = 1; i < count; i++) {
+        gz_index_worker *w = &workers[i];
+#ifdef _WIN32
+        w->thread = CreateThread(NULL, 0, gz_index_thread_proc, w, 0, NULL);
+        w->started = w->thread != NULL;
+#else
+        w->started = pthread_create(&w->thread, NULL, gz_index_thread_proc, w) == 0;
+#endif
+    }
+    for (i = 0; i < count; i++) {
+        if (i == 0 || !workers[i].started)
+            gz_index_work(&workers[i]);
+    }
+    for (i = 0; i < count; i++) {
+        gz_index_worker *w = &workers[i];
+        if (w->started) {
+#ifdef _WIN32
+            WaitForSingleObject(w->thread, INFINITE);
+            CloseHandle(w->thread);
+#else
+            pthread_join(w->thread, NULL);
+#endif
+        }
+        error |= w->error;
+    }
+    free(workers);
+    return error ? -1 : len;
+}
@@ -0,0 +1,76 @@
+/*
+ * Random access to existing gzip files with an index of inflate checkpoints.
+ * For details and updates please visit
+ * https://github.com/gildor2/fast_zlib
+ * Licensed under the BSD license. See LICENSE.txt file in the project root for full license information.
+ */
+
+#ifndef GZINDEX_H
+#define GZINDEX_H
+
+#include "zlib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Files written by gzseek.c have flush points where decompression could start from
+ * scratch. Other gzip files don't have them, but inflate could be resumed at any deflate
+ * block boundary when the last 32 KB of uncompressed data (the window) and the bit offset
+ * of the block in compressed data are known - this is how zlib's examples/zran.c works.
+ * gzIndexBuild() decompresses a file once and saves such checkpoints about every "span"
+ * bytes of uncompressed data. Windows are stored compressed, so the index takes a few
+ * KB per checkpoint.
+ *
+ * gzIndexRead() starts inflate at the closest checkpoint before the requested offset, so
+ * a read decompresses at most "span" bytes more than requested. Parts of a long range
+ * between checkpoints are independent, and they're decompressed by several threads.
+ *
+ * Only the first gzip member (or zlib stream) is indexed, data after it is ignored.
+ *
+ * Index file format: 4 bytes "FZIX", 4-byte version, 8-byte span, 8-byte size of
+ * uncompressed data, 8-byte number of checkpoints. Every checkpoint has 8-byte offset in
+ * uncompressed data, 8-byte offset of the first complete byte of the block in compressed
+ * data, 1 byte with the number of bits of the block in the previous byte, 4-byte window
+ * size, 4-byte size of compressed window and the window compressed as a zlib stream. All
+ * numbers are little endian.
+ */
+
+#define GZ_INDEX_DEFAULT_SPAN   (1 << 20)
+
+typedef struct gz_index_s *gzIndex;
+
+ZEXTERN int ZEXPORT gzIndexBuild OF((const char *path, long long span, gzIndex *index));
+/* Decompress the whole file and build its index. Returns Z_OK, Z_ERRNO when the file
+ * couldn't be read, Z_DATA_ERROR for damaged or truncated data, or Z_MEM_ERROR.
+ */
+
+ZEXTERN int ZEXPORT gzIndexSave OF((gzIndex index, const char *path));
+ZEXTERN int ZEXPORT gzIndexLoad OF((const char *path, gzIndex *index));
+/* Write the index to a file and read it back. Return Z_OK, Z_ERRNO for I/O errors,
+ * Z_DATA_ERROR for a damaged index file, or Z_MEM_ERROR.
+ */
+
+ZEXTERN long long ZEXPORT gzIndexSize OF((gzIndex index));
+/* Size of uncompressed data */
+
+ZEXTERN long long ZEXPORT gzIndexPoints OF((gzIndex index));
+/* Number of checkpoints */
+
+ZEXTERN long long ZEXPORT gzIndexRead OF((gzIndex index, const char *path, long long offset,
+                                          voidp buf, long long len, unsigned numThreads));
+/* Read up to len bytes of uncompressed data of the indexed file starting at offset, like
+ * pread(). Returns the number of bytes read, which is less than len at the end of data,
+ * or -1 in case of error. numThreads is the number of additional threads, which are
+ * started when the range covers several checkpoints; 0 decompresses everything in the
+ * calling thread. The index is not modified, so it could be used by several threads at
+ * the same time.
+ */
+
+ZEXTERN void ZEXPORT gzIndexFree OF((gzIndex index));
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GZINDEX_H */
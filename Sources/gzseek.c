@@ -0,0 +1,434 @@
+/*
+ * Seekable gzip files: writer with regular flush points and reader with random access.
+ * For details and updates please visit
+ * https://github.com/gildor2/fast_zlib
+ * Licensed under the BSD license. See LICENSE.txt file in the project root for full license information.
+ */
+
+#if !defined(_WIN32) && !defined(_FILE_OFFSET_BITS)
+#define _FILE_OFFSET_BITS 64
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gzseek.h"
+
+#ifdef _WIN32
+#define FSEEK64(f, pos)     _fseeki64(f, pos, SEEK_SET)
+#else
+#define FSEEK64(f, pos)     fseeko(f, (off_t)(pos), SEEK_SET)
+#endif
+
+/* Size of compressed data buffers of writer and reader */
+#define GZ_SEEK_BUFSIZE     (1 << 18)
+
+#define GZ_SEEK_MAGIC       "FZGI"
+#define GZ_SEEK_VERSION     1
+#define GZ_SEEK_HEADER      32          /* magic, version, interval, size, count */
+
+#ifndef local
+#define local static
+#endif
+
+typedef struct {
+    long long upos;                     /* offset in uncompressed data */
+    long long cpos;                     /* offset in the gzip file */
+} gz_seek_point;
+
+/* ===========================================================================
+ * Index
+ */
+
+local void put_u32(unsigned char *p, unsigned v)
+{
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+    p[2] = (unsigned char)(v >> 16);
+    p[3] = (unsigned char)(v >> 24);
+}
+
+local void put_u64(unsigned char *p, long long v)
+{
+    put_u32(p, (unsigned)v);
+    put_u32(p + 4, (unsigned)((unsigned long long)v >> 32));
+}
+
+local unsigned get_u32(const unsigned char *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned)p[3] << 24);
+}
+
+local long long get_u64(const unsigned char *p)
+{
+    return (long long)(get_u32(p) | ((unsigned long long)get_u32(p + 4) << 32));
+}
+
+local int write_index(FILE *f, long long interval, long long size, const gz_seek_point *points, long long count)
+{
+    unsigned char buf[GZ_SEEK_HEADER];
+    long long i;
+
+    memcpy(buf, GZ_SEEK_MAGIC, 4);
+    put_u32(buf + 4, GZ_SEEK_VERSION);
+    put_u64(buf + 8, interval);
+    put_u64(buf + 16, size);
+    put_u64(buf + 24, count);
+    if (fwrite(buf, GZ_SEEK_HEADER, 1, f) != 1) return 0;
+    for (i = 0; i < count; i++) {
+        put_u64(buf, points[i].upos);
+        put_u64(buf + 8, points[i].cpos);
+        if (fwrite(buf, 16, 1, f) != 1) return 0;
+    }
+    return 1;
+}
+
+/* Load and validate the index, returns the array of points or NULL */
+local gz_seek_point *read_index(FILE *f, long long *size, long long *count)
+{
+    unsigned char buf[GZ_SEEK_HEADER];
+    gz_seek_point *points;
+    long long i;
+
+    if (fread(buf, GZ_SEEK_HEADER, 1, f) != 1) return NULL;
+    if (memcmp(buf, GZ_SEEK_MAGIC, 4) != 0 || get_u32(buf + 4) != GZ_SEEK_VERSION) return NULL;
+    *size = get_u64(buf + 16);
+    *count = get_u64(buf + 24);
+    if (*size < 0 || *count < 1 || (unsigned long long)*count > ((size_t)-1) / sizeof(gz_seek_point))
+        return NULL;
+
+    points = (gz_seek_point *)malloc((size_t)*count * sizeof(gz_seek_point));
+    if (points == NULL) return NULL;
+    for (i = 0; i < *count; i++) {
+        if (fread(buf, 16, 1, f) != 1) break;
+        points[i].upos = get_u64(buf);
+        points[i].cpos = get_u64(buf + 8);
+        /* points are in increasing order, the first one is the file start */
+        if (i == 0 ? (points[0].upos != 0 || points[0].cpos != 0) :
+            (points[i].upos <= points[i-1].upos || points[i].cpos <= points[i-1].cpos ||
+             points[i].upos > *size))
+            break;
+    }
+    if (i < *count) {
+        free(points);
+        return NULL;
+    }
+    return points;
+}
+
+/* ===========================================================================
+ * Writer
+ */
+
+struct gz_seek_writer_s {
+    z_stream strm;
+    FILE *file;
+    FILE *index;
+    unsigned char *buf;
+    long long interval;
+    long long upos;                     /* uncompressed bytes consumed by deflate */
+    long long cpos;                     /* compressed bytes produced by deflate */
+    long long next;                     /* uncompressed offset of the next flush point */
+    gz_seek_point *points;
+    long long count;
+    long long capacity;
+    int error;                          /* bool, some write has failed */
+};
+
+/* Write out everything deflate has produced into the buffer */
+local void gz_seek_output(gzSeekWriter gz)
+{
+    unsigned len = GZ_SEEK_BUFSIZE - gz->strm.avail_out;
+    if (len && fwrite(gz->buf, 1, len, gz->file) != len) gz->error = 1;
+    gz->cpos += len;
+    gz->strm.next_out = gz->buf;
+    gz->strm.avail_out = GZ_SEEK_BUFSIZE;
+}
+
+local void gz_seek_add_point(gzSeekWriter gz)
+{
+    if (gz->count == gz->capacity) {
+        long long capacity = gz->capacity ? gz->capacity * 2 : 64;
+        gz_seek_point *points = (gz_seek_point *)realloc(gz->points, (size_t)capacity * sizeof(gz_seek_point));
+        if (points == NULL) {
+            gz->error = 1;
+            return;
+        }
+        gz->points = points;
+        gz->capacity = capacity;
+    }
+    gz->points[gz->count].upos = gz->upos;
+    gz->points[gz->count].cpos = gz->cpos;
+    gz->count++;
+}
+
+gzSeekWriter ZEXPORT gzSeekCreate(path, indexPath, mode, interval)
+    const char *path;
+    const char *indexPath;
+    const char *mode;
+    long long interval;
+{
+    gzSeekWriter gz;
+    int level = Z_DEFAULT_COMPRESSION;
+    int strategy = Z_DEFAULT_STRATEGY;
+    int writing = 0;
+
+    /* parse the mode string the same way as gzopen() */
+    for ( ; *mode; mode++) {
+        if (*mode >= '0' && *mode <= '9') level = *mode - '0';
+        else switch (*mode) {
+        case 'w': writing = 1; break;
+        case 'f': strategy = Z_FILTERED; break;
+        case 'h': strategy = Z_HUFFMAN_ONLY; break;
+        case 'R': strategy = Z_RLE; break;
+        case 'F': strategy = Z_FIXED; break;
+        case 'a': case 'r': case 'T': return NULL;
+        default: break;
+        }
+    }
+    if (!writing || interval <= 0) return NULL;
+
+    gz = (gzSeekWriter)calloc(1, sizeof(*gz));
+    if (gz == NULL) return NULL;
+    gz->buf = (unsigned char *)malloc(GZ_SEEK_BUFSIZE);
+    if (gz->buf == NULL) goto fail_alloc;
+    /* 31 = gzip wrapper with 32K window */
+    if (deflateInit2(&gz->strm, level, Z_DEFLATED, 31, 8, strategy) != Z_OK) goto fail_alloc;
+    gz->strm.next_out = gz->buf;
+    gz->strm.avail_out = GZ_SEEK_BUFSIZE;
+    gz->interval = interval;
+    gz->next = interval;
+
+    gz->file = fopen(path, "wb");
+    if (gz->file == NULL) goto fail_deflate;
+    gz->index = fopen(indexPath, "wb");
+    if (gz->index == NULL) goto fail_file;
+
+    /* the gzip header is decompressed from the file start */
+    gz_seek_add_point(gz);
+    if (gz->error) goto fail_index;
+    return gz;
+
+fail_index:
+    fclose(gz->index);
+fail_file:
+    fclose(gz->file);
+fail_deflate:
+    deflateEnd(&gz->strm);
+fail_alloc:
+    free(gz->buf);
+    free(gz);
+    return NULL;
+}
+
+int ZEXPORT gzSeekWrite(gz, buf, len)
+    gzSeekWriter gz;
+    voidpc buf;
+    unsigned len;
+{
+    const Bytef *next = (const Bytef *)buf;
+    unsigned left = len;
+
+    if (gz == NULL || gz->error || (int)len < 0) return 0;
+    while (left) {
+        /* feed deflate up to the next flush point */
+        unsigned n = left;
+        if ((long long)n > gz->next - gz->upos) n = (unsigned)(gz->next - gz->upos);
+        gz->strm.next_in = (z_const Bytef *)next;
+        gz->strm.avail_in = n;
+        while (gz->strm.avail_in) {
+            deflate(&gz->strm, Z_NO_FLUSH);
+            if (gz->strm.avail_out == 0) gz_seek_output(gz);
+        }
+        next += n;
+        left -= n;
+        gz->upos += n;
+
+        if (gz->upos == gz->next) {
+            /* flush is complete when deflate has space left in the output buffer */
+            for (;;) {
+                deflate(&gz->strm, Z_FULL_FLUSH);
+                if (gz->strm.avail_out != 0) break;
+                gz_seek_output(gz);
+            }
+            gz_seek_output(gz);
+            gz->next += gz->interval;
+            gz_seek_add_point(gz);
+        }
+        if (gz->error) return 0;
+    }
+    return (int)len;
+}
+
+int ZEXPORT gzSeekClose(gz)
+    gzSeekWriter gz;
+{
+    int ret;
+    if (gz == NULL) return Z_STREAM_ERROR;
+
+    gz->strm.avail_in = 0;
+    while (deflate(&gz->strm, Z_FINISH) == Z_OK)
+        gz_seek_output(gz);
+    gz_seek_output(gz);
+    deflateEnd(&gz->strm);
+
+    /* a point at the very end of data is useless */
+    if (gz->count > 1 && gz->points[gz->count-1].upos == gz->upos) gz->count--;
+    if (!gz->error && !write_index(gz->index, gz->interval, gz->upos, gz->points, gz->count))
+        gz->error = 1;
+    if (fclose(gz->file) != 0) gz->error = 1;
+    if (fclose(gz->index) != 0) gz->error = 1;
+
+    ret = gz->error ? Z_ERRNO : Z_OK;
+    free(gz->points);
+    free(gz->buf);
+    free(gz);
+    return ret;
+}
+
+/* ===========================================================================
+ * Reader
+ */
+
+struct gz_seek_reader_s {
+    z_stream strm;
+    FILE *file;
+    unsigned char *buf;
+    gz_seek_point *points;
+    long long count;
+    long long size;                     /* size of uncompressed data */
+    long long pos;                      /* uncompressed offset of the next inflate() output */
+    int active;                         /* bool, strm continues from pos */
+    int eof;                            /* bool, end of deflate stream */
+};
+
+/* Index of the last point at or before offset */
+local long long gz_seek_find(gzSeekReader gz, long long offset)
+{
+    long long lo = 0, hi = gz->count - 1;
+    while (lo < hi) {
+        long long mid = (lo + hi + 1) / 2;
+        if (gz->points[mid].upos <= offset) lo = mid;
+        else hi = mid - 1;
+    }
+    return lo;
+}
+
+/* Start decompression from the point, returns 0 in case of error */
+local int gz_seek_start(gzSeekReader gz, long long point)
+{
+    const gz_seek_point *p = &gz->points[point];
+    gz->active = 0;
+    if (FSEEK64(gz->file, p->cpos) != 0) return 0;
+    /* the first point has the gzip header, others are raw deflate after a full flush */
+    if (inflateReset2(&gz->strm, point == 0 ? 31 : -MAX_WBITS) != Z_OK) return 0;
+    gz->strm.avail_in = 0;
+    gz->pos = p->upos;
+    gz->eof = 0;
+    gz->active = 1;
+    return 1;
+}
+
+/* Decompress up to len bytes, returns the number of bytes or -1 in case of error */
+local int gz_seek_inflate(gzSeekReader gz, unsigned char *out, unsigned len)
+{
+    int ret;
+
+    gz->strm.next_out = out;
+    gz->strm.avail_out = len;
+    while (gz->strm.avail_out && !gz->eof) {
+        if (gz->strm.avail_in == 0) {
+            gz->strm.next_in = gz->buf;
+            gz->strm.avail_in = (uInt)fread(gz->buf, 1, GZ_SEEK_BUFSIZE, gz->file);
+            if (gz->strm.avail_in == 0) break;      /* truncated file */
+        }
+        ret = inflate(&gz->strm, Z_NO_FLUSH);
+        if (ret == Z_STREAM_END) gz->eof = 1;
+        else if (ret != Z_OK) break;
+    }
+    len -= gz->strm.avail_out;
+    gz->pos += len;
+    if (gz->strm.avail_out && !gz->eof) {
+        gz->active = 0;
+        return -1;
+    }
+    return (int)len;
+}
+
+gzSeekReader ZEXPORT gzSeekOpen(path, indexPath)
+    const char *path;
+    const char *indexPath;
+{
+    gzSeekReader gz;
+    FILE *index;
+
+    gz = (gzSeekReader)calloc(1, sizeof(*gz));
+    if (gz == NULL) return NULL;
+
+    index = fopen(indexPath, "rb");
+    if (index == NULL) goto fail_alloc;
+    gz->points = read_index(index, &gz->size, &gz->count);
+    fclose(index);
+    if (gz->points == NULL) goto fail_alloc;
+
+    gz->buf = (unsigned char *)malloc(GZ_SEEK_BUFSIZE);
+    if (gz->buf == NULL) goto fail_alloc;
+    if (inflateInit2(&gz->strm, 31) != Z_OK) goto fail_alloc;
+    gz->file = fopen(path, "rb");
+    if (gz->file == NULL) goto fail_inflate;
+    return gz;
+
+fail_inflate:
+    inflateEnd(&gz->strm);
+fail_alloc:
+    free(gz->buf);
+    free(gz->points);
+    free(gz);
+    return NULL;
+}
+
+long long ZEXPORT gzSeekSize(gz)
+    gzSeekReader gz;
+{
+    return gz ? gz->size : -1;
+}
+
+int ZEXPORT gzSeekRead(gz, offset, buf, len)
+    gzSeekReader gz;
+    long long offset;
+    voidp buf;
+    unsigned len;
+{
+    long long point;
+    unsigned char skip[4096];
+
+    if (gz == NULL || offset < 0 || (int)len < 0) return -1;
+    if (offset >= gz->size || len == 0) return 0;
+
+    /* continue the current stream unless there's a closer point to start from */
+    point = gz_seek_find(gz, offset);
+    if (!gz->active || offset < gz->pos || gz->points[point].upos > gz->pos) {
+        if (!gz_seek_start(gz, point)) return -1;
+    }
+
+    /* skip data between the point and offset */
+    while (gz->pos < offset) {
+        unsigned n = sizeof(skip);
+        if ((long long)n > offset - gz->pos) n = (unsigned)(offset - gz->pos);
+        if (gz_seek_inflate(gz, skip, n) != (int)n) return -1;
+    }
+    return gz_seek_inflate(gz, (unsigned char *)buf, len);
+}
+
+int ZEXPORT gzSeekCloseReader(gz)
+    gzSeekReader gz;
+{
+    if (gz == NULL) return Z_STREAM_ERROR;
+    inflateEnd(&gz->strm);
+    fclose(gz->file);
+    free(gz->buf);
+    free(gz->points);
+    free(gz);
+    return Z_OK;
+}
@@ -0,0 +1,82 @@
+/*
+ * Seekable gzip files: writer with regular flush points and reader with random access.
+ * For details and updates please visit
+ * https://github.com/gildor2/fast_zlib
+ * Licensed under the BSD license. See LICENSE.txt file in the project root for full license information.
+ */
+
+#ifndef GZSEEK_H
+#define GZSEEK_H
+
+#include "zlib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Reading a range of data from the middle of a gzip file normally requires decompression
+ * from the start. The writer compresses data into a gzip stream and flushes it with
+ * Z_FULL_FLUSH every "interval" bytes of uncompressed data: the deflate block ends there,
+ * the compressed stream is aligned to a byte, and following data doesn't refer to anything
+ * before it. Positions of these points in uncompressed and compressed data are written to
+ * a separate index file. The gzip file itself is a regular one, readable by any tool.
+ *
+ * The reader finds the closest flush point before the requested position in the index,
+ * and decompresses from there, so a read costs at most "interval" bytes of inflate. Reads
+ * continuing the previous one don't seek at all. Each flush point makes the compressed
+ * file a few bytes larger and resets matching history, so very small intervals reduce
+ * the compression ratio; 1 MB is a reasonable default.
+ *
+ * Index file format: 4 bytes "FZGI", 4-byte version, 8-byte interval, 8-byte size of
+ * uncompressed data, 8-byte number of points, then pairs of 8-byte uncompressed and
+ * compressed offsets. All numbers are little endian. The first point is always (0, 0),
+ * the start of the gzip header; decompression from other points uses raw inflate.
+ *
+ * File objects should be used from one thread only.
+ */
+
+#define GZ_SEEK_DEFAULT_INTERVAL    (1 << 20)
+
+typedef struct gz_seek_writer_s *gzSeekWriter;
+typedef struct gz_seek_reader_s *gzSeekReader;
+
+ZEXTERN gzSeekWriter ZEXPORT gzSeekCreate OF((const char *path, const char *indexPath,
+                                             const char *mode, long long interval));
+/* Create a gzip file and its index for writing. mode is the same as for gzopen(), but it
+ * should be a write mode: "wb6" etc; append mode is not supported. Returns NULL if the
+ * files couldn't be created or interval is not positive.
+ */
+
+ZEXTERN int ZEXPORT gzSeekWrite OF((gzSeekWriter file, voidpc buf, unsigned len));
+/* Compress and write data, returns the number of uncompressed bytes written or 0 in case
+ * of error, the same as gzwrite(). Data is compressed with deflate() directly, so exact
+ * offsets of flush points in the file are known; the output is the same gzip stream.
+ */
+
+ZEXTERN int ZEXPORT gzSeekClose OF((gzSeekWriter file));
+/* Finish compression, write the index and close both files. Returns Z_OK, or Z_ERRNO
+ * when some write has failed.
+ */
+
+ZEXTERN gzSeekReader ZEXPORT gzSeekOpen OF((const char *path, const char *indexPath));
+/* Open a gzip file written by gzSeekCreate() for random access. Returns NULL if any of
+ * files couldn't be opened, or the index is damaged.
+ */
+
+ZEXTERN long long ZEXPORT gzSeekSize OF((gzSeekReader file));
+/* Size of uncompressed data, known from the index */
+
+ZEXTERN int ZEXPORT gzSeekRead OF((gzSeekReader file, long long offset, voidp buf, unsigned len));
+/* Read up to len bytes of uncompressed data starting at offset, like pread(). Returns
+ * the number of bytes read, which is less than len at the end of data, or -1 in case of
+ * error (damaged file or I/O error).
+ */
+
+ZEXTERN int ZEXPORT gzSeekCloseReader OF((gzSeekReader file));
+/* Close the file and free memory */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GZSEEK_H */
@@ -0,0 +1,544 @@
+/*
+ * Gzip file writer which overlaps compression with file output.
+ * For details and updates please visit
+ * https://github.com/gildor2/fast_zlib
+ * Licensed under the BSD license. See LICENSE.txt file in the project root for full license information.
+ */
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "gzwrite_async.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#endif
+
+#if defined(__linux__) && !defined(GZ_ASYNC_NO_URING)
+#include <sys/syscall.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+#define USE_URING 1
+#endif
+#endif
+
+/* Size of each of two output buffers */
+#define GZ_ASYNC_BUFSIZE    (1 << 20)
+
+#ifndef local
+#define local static
+#endif
+
+#ifdef _WIN32
+typedef HANDLE file_t;
+#define BAD_FILE    INVALID_HANDLE_VALUE
+#else
+typedef int file_t;
+#define BAD_FILE    (-1)
+#endif
+
+/* ===========================================================================
+ * io_uring without liburing: a ring with 2 entries, only one write is in flight
+ * at any time.
+ */
+#ifdef USE_URING
+
+typedef struct {
+    int fd;
+    void *sq_ptr;
+    void *cq_ptr;
+    size_t sq_size;
+    size_t cq_size;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+    struct iovec iov;
+} uring_t;
+
+local int uring_init(uring_t *ring)
+{
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    ring->fd = (int)syscall(__NR_io_uring_setup, 2, &p);
+    if (ring->fd < 0) return 0;
+
+    ring->sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    ring->cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_size > ring->sq_size) ring->sq_size = ring->cq_size;
+        ring->cq_size = ring->sq_size;
+    }
+    ring->sq_ptr = mmap(NULL, ring->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ptr == MAP_FAILED) goto fail;
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_ptr = ring->sq_ptr;
+    } else {
+        ring->cq_ptr = mmap(NULL, ring->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                            ring->fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ptr == MAP_FAILED) {
+            munmap(ring->sq_ptr, ring->sq_size);
+            goto fail;
+        }
+    }
+    ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = (struct io_uring_sqe *)mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+                                             MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        if (ring->cq_ptr != ring->sq_ptr) munmap(ring->cq_ptr, ring->cq_size);
+        munmap(ring->sq_ptr, ring->sq_size);
+        goto fail;
+    }
+
+    ring->sq_tail  = (unsigned *)((char *)ring->sq_ptr + p.sq_off.tail);
+    ring->sq_mask  = (unsigned *)((char *)ring->sq_ptr + p.sq_off.ring_mask);
+    ring->sq_array = (unsigned *)((char *)ring->sq_ptr + p.sq_off.array);
+    ring->cq_head  = (unsigned *)((char *)ring->cq_ptr + p.cq_off.head);
+    ring->cq_tail  = (unsigned *)((char *)ring->cq_ptr + p.cq_off.tail);
+    ring->cq_mask  = (unsigned *)((char *)ring->cq_ptr + p.cq_off.ring_mask);
+    ring->cqes     = (struct io_uring_cqe *)((char *)ring->cq_ptr + p.cq_off.cqes);
+    return 1;
+
+fail:
+    close(ring->fd);
+    return 0;
+}
+
+local void uring_free(uring_t *ring)
+{
+    munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_ptr != ring->sq_ptr) munmap(ring->cq_ptr, ring->cq_size);
+    munmap(ring->sq_ptr, ring->sq_size);
+    close(ring->fd);
+}
+
+/* Queue a write, returns 0 on error */
+local int uring_submit(uring_t *ring, int fd, const unsigned char *buf, unsigned len, long long offset)
+{
+    unsigned tail = *ring->sq_tail;
+    unsigned index = tail & *ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+
+    /* IORING_OP_WRITEV is available since the first io_uring kernel */
+    ring->iov.iov_base = (void *)buf;
+    ring->iov.iov_len = len;
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_WRITEV;
+    sqe->fd = fd;
+    sqe->addr = (unsigned long)&ring->iov;
+    sqe->len = 1;
+    sqe->off = (unsigned long long)offset;
+    ring->sq_array[index] = index;
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+    return syscall(__NR_io_uring_enter, ring->fd, 1, 0, 0, NULL, 0) == 1;
+}
+
+/* Wait for the queued write, returns its result: number of written bytes or -errno */
+local int uring_wait(uring_t *ring)
+{
+    unsigned head;
+    int res;
+    for (;;) {
+        head = *ring->cq_head;
+        if (head != __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) break;
+        if (syscall(__NR_io_uring_enter, ring->fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0 &&
+            errno != EINTR)
+            return -errno;
+    }
+    res = ring->cqes[head & *ring->cq_mask].res;
+    __atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+    return res;
+}
+
+#endif /* USE_URING */
+
+/* ===========================================================================
+ * Writer thread, used when io_uring is not available.
+ */
+
+typedef struct {
+    file_t file;
+    const unsigned char *buf;           /* job: write len bytes from buf at offset */
+    unsigned len;
+    long long offset;
+    int result;                         /* bool, job succeeded */
+    int pending;                        /* bool, job was submitted and not completed yet */
+    int quit;
+#ifdef _WIN32
+    HANDLE thread;
+    HANDLE jobReady;
+    HANDLE jobDone;
+#else
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+#endif
+} writer_t;
+
+/* Synchronous write of the whole buffer */
+local int write_all(file_t file, const unsigned char *buf, unsigned len, long long offset)
+{
+#ifdef _WIN32
+    DWORD written;
+    (void)offset;                       /* writes are sequential, file pointer is always at offset */
+    while (len > 0) {
+        if (!WriteFile(file, buf, len, &written, NULL)) return 0;
+        buf += written;
+        len -= written;
+    }
+#else
+    while (len > 0) {
+        ssize_t written = pwrite(file, buf, len, (off_t)offset);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return 0;
+        }
+        buf += written;
+        len -= (unsigned)written;
+        offset += written;
+    }
+#endif
+    return 1;
+}
+
+#ifdef _WIN32
+
+local DWORD WINAPI writer_thread(LPVOID param)
+{
+    writer_t *w = (writer_t *)param;
+    for (;;) {
+        WaitForSingleObject(w->jobReady, INFINITE);
+        if (w->quit) break;
+        w->result = write_all(w->file, w->buf, w->len, w->offset);
+        SetEvent(w->jobDone);
+    }
+    return 0;
+}
+
+local int writer_init(writer_t *w, file_t file)
+{
+    memset(w, 0, sizeof(*w));
+    w->file = file;
+    w->jobReady = CreateEvent(NULL, FALSE, FALSE, NULL);
+    w->jobDone = CreateEvent(NULL, FALSE, FALSE, NULL);
+    w->thread = CreateThread(NULL, 0, writer_thread, w, 0, NULL);
+    if (!w->jobReady || !w->jobDone || !w->thread) return 0;
+    return 1;
+}
+
+local void writer_submit(writer_t *w, const unsigned char *buf, unsigned len, long long offset)
+{
+    w->buf = buf;
+    w->len = len;
+    w->offset = offset;
+    w->pending = 1;
+    SetEvent(w->jobReady);
+}
+
+local int writer_wait(writer_t *w)
+{
+    if (w->pending) {
+        WaitForSingleObject(w->jobDone, INFINITE);
+        w->pending = 0;
+    }
+    return w->result;
+}
+
+local void writer_free(writer_t *w)
+{
+    if (w->thread) {
+        w->quit = 1;
+        SetEvent(w->jobReady);
+        WaitForSingleObject(w->thread, INFINITE);
+        CloseHandle(w->thread);
+    }
+    if (w->jobReady) CloseHandle(w->jobReady);
+    if (w->jobDone) CloseHandle(w->jobDone);
+}
+
+#else /* _WIN32 */
+
+local void *writer_thread(void *param)
+{
+    writer_t *w = (writer_t *)param;
+    pthread_mutex_lock(&w->lock);
+    for (;;) {
+        while (!w->pending && !w->quit)
+            pthread_cond_wait(&w->cond, &w->lock);
+        if (w->quit) break;
+        pthread_mutex_unlock(&w->lock);
+        w->result = write_all(w->file, w->buf, w->len, w->offset);
+        pthread_mutex_lock(&w->lock);
+        w->pending = 0;
+        pthread_cond_broadcast(&w->cond);
+    }
+    pthread_mutex_unlock(&w->lock);
+    return NULL;
+}
+
+local int writer_init(writer_t *w, file_t file)
+{
+    memset(w, 0, sizeof(*w));
+    w->file = file;
+    w->result = 1;
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->cond, NULL);
+    if (pthread_create(&w->thread, NULL, writer_thread, w) != 0) {
+        pthread_cond_destroy(&w->cond);
+        pthread_mutex_destroy(&w->lock);
+        return 0;
+    }
+    return 1;
+}
+
+local void writer_submit(writer_t *w, const unsigned char *buf, unsigned len, long long offset)
+{
+    pthread_mutex_lock(&w->lock);
+    w->buf = buf;
+    w->len = len;
+    w->offset = offset;
+    w->pending = 1;
+    pthread_cond_broadcast(&w->cond);
+    pthread_mutex_unlock(&w->lock);
+}
+
+local int writer_wait(writer_t *w)
+{
+    pthread_mutex_lock(&w->lock);
+    while (w->pending)
+        pthread_cond_wait(&w->cond, &w->lock);
+    pthread_mutex_unlock(&w->lock);
+    return w->result;
+}
+
+local void writer_free(writer_t *w)
+{
+    pthread_mutex_lock(&w->lock);
+    w->quit = 1;
+    pthread_cond_broadcast(&w->cond);
+    pthread_mutex_unlock(&w->lock);
+    pthread_join(w->thread, NULL);
+    pthread_cond_destroy(&w->cond);
+    pthread_mutex_destroy(&w->lock);
+}
+
+#endif /* _WIN32 */
+
+/* ===========================================================================
+ * Gzip file
+ */
+
+struct gz_async_s {
+    z_stream strm;
+    file_t file;
+    unsigned char *buf[2];
+    int cur;                            /* index of the buffer being filled by deflate() */
+    long long offset;                   /* file offset of the next write */
+    int pending;                        /* bool, a write is in flight */
+    unsigned pending_len;
+    int error;                          /* bool, some write has failed */
+#ifdef USE_URING
+    int use_uring;
+    uring_t ring;
+#endif
+    writer_t writer;
+};
+
+/* Wait for completion of the write which is in flight */
+local void gz_async_wait(gzAsyncFile gz)
+{
+    if (!gz->pending) return;
+    gz->pending = 0;
+#ifdef USE_URING
+    if (gz->use_uring) {
+        const unsigned char *buf = gz->buf[gz->cur ^ 1];
+        unsigned len = gz->pending_len;
+        long long offset = gz->offset - len;
+        for (;;) {
+            int res = uring_wait(&gz->ring);
+            if (res <= 0) {
+                if (res == -EINTR || res == -EAGAIN) res = 0;
+                else {
+                    gz->error = 1;
+                    return;
+                }
+            }
+            /* short write, resubmit the rest */
+            buf += res;
+            len -= res;
+            offset += res;
+            if (len == 0) return;
+            if (!uring_submit(&gz->ring, gz->file, buf, len, offset)) {
+                gz->error = 1;
+                return;
+            }
+        }
+    }
+#endif
+    if (!writer_wait(&gz->writer)) gz->error = 1;
+}
+
+/* Start writing of the current buffer and switch deflate() to the other one */
+local void gz_async_flush(gzAsyncFile gz)
+{
+    unsigned len = GZ_ASYNC_BUFSIZE - gz->strm.avail_out;
+    const unsigned char *buf = gz->buf[gz->cur];
+
+    /* only one write could be in flight, and it uses the buffer we'll switch to */
+    gz_async_wait(gz);
+    if (len) {
+#ifdef USE_URING
+        if (gz->use_uring) {
+            if (!uring_submit(&gz->ring, gz->file, buf, len, gz->offset)) {
+                gz->error = 1;
+                return;
+            }
+        } else
+#endif
+        writer_submit(&gz->writer, buf, len, gz->offset);
+        gz->pending = 1;
+        gz->pending_len = len;
+        gz->offset += len;
+        gz->cur ^= 1;
+    }
+    gz->strm.next_out = gz->buf[gz->cur];
+    gz->strm.avail_out = GZ_ASYNC_BUFSIZE;
+}
+
+gzAsyncFile ZEXPORT gzAsyncOpen(path, mode)
+    const char *path;
+    const char *mode;
+{
+    gzAsyncFile gz;
+    int level = Z_DEFAULT_COMPRESSION;
+    int strategy = Z_DEFAULT_STRATEGY;
+    int writing = 0;
+
+    /* parse the mode string the same way as gzopen() */
+    for ( ; *mode; mode++) {
+        if (*mode >= '0' && *mode <= '9') level = *mode - '0';
+        else switch (*mode) {
+        case 'w': writing = 1; break;
+        case 'f': strategy = Z_FILTERED; break;
+        case 'h': strategy = Z_HUFFMAN_ONLY; break;
+        case 'R': strategy = Z_RLE; break;
+        case 'F': strategy = Z_FIXED; break;
+        case 'a': case 'r': case 'T': return NULL;
+        default: break;
+        }
+    }
+    if (!writing) return NULL;
+
+    gz = (gzAsyncFile)calloc(1, sizeof(*gz));
+    if (gz == NULL) return NULL;
+    gz->buf[0] = (unsigned char *)malloc(GZ_ASYNC_BUFSIZE);
+    gz->buf[1] = (unsigned char *)malloc(GZ_ASYNC_BUFSIZE);
+    if (gz->buf[0] == NULL || gz->buf[1] == NULL) goto fail_alloc;
+    /* 31 = gzip wrapper with 32K window */
+    if (deflateInit2(&gz->strm, level, Z_DEFLATED, 31, 8, strategy) != Z_OK) goto fail_alloc;
+    gz->strm.next_out = gz->buf[0];
+    gz->strm.avail_out = GZ_ASYNC_BUFSIZE;
+
+#ifdef _WIN32
+    gz->file = CreateFileA(path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+#else
+    gz->file = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+#endif
+    if (gz->file == BAD_FILE) goto fail_deflate;
+
+#ifdef USE_URING
+    gz->use_uring = uring_init(&gz->ring);
+    if (!gz->use_uring)
+#endif
+    if (!writer_init(&gz->writer, gz->file)) goto fail_file;
+    return gz;
+
+fail_file:
+#ifdef _WIN32
+    CloseHandle(gz->file);
+#else
+    close(gz->file);
+#endif
+fail_deflate:
+    deflateEnd(&gz->strm);
+fail_alloc:
+    free(gz->buf[0]);
+    free(gz->buf[1]);
+    free(gz);
+    return NULL;
+}
+
+int ZEXPORT gzAsyncWrite(gz, buf, len)
+    gzAsyncFile gz;
+    voidpc buf;
+    unsigned len;
+{
+    if (gz == NULL || gz->error || (int)len < 0) return 0;
+    gz->strm.next_in = (z_const Bytef *)buf;
+    gz->strm.avail_in = len;
+    while (gz->strm.avail_in) {
+        deflate(&gz->strm, Z_NO_FLUSH);
+        if (gz->strm.avail_out == 0) gz_async_flush(gz);
+        if (gz->error) return 0;
+    }
+    return (int)len;
+}
+
+int ZEXPORT gzAsyncClose(gz)
+    gzAsyncFile gz;
+{
+    int ret;
+    if (gz == NULL) return Z_STREAM_ERROR;
+
+    gz->strm.avail_in = 0;
+    while (deflate(&gz->strm, Z_FINISH) == Z_OK)
+        gz_async_flush(gz);
+    gz_async_flush(gz);
+    gz_async_wait(gz);
+    deflateEnd(&gz->strm);
+
+#ifdef USE_URING
+    if (gz->use_uring) uring_free(&gz->ring);
+    else
+#endif
+    writer_free(&gz->writer);
+#ifdef _WIN32
+    if (!CloseHandle(gz->file)) gz->error = 1;
+#else
+    if (close(gz->file) != 0) gz->error = 1;
+#endif
+
+    ret = gz->error ? Z_ERRNO : Z_OK;
+    free(gz->buf[0]);
+    free(gz->buf[1]);
+    free(gz);
+    return ret;
+}
+
+const char * ZEXPORT gzAsyncBackend(gz)
+    gzAsyncFile gz;
+{
+#ifdef USE_URING
+    if (gz->use_uring) return "io_uring";
+#endif
+    (void)gz;
+    return "thread";
+}
@@ -0,0 +1,52 @@
+/*
+ * Gzip file writer which overlaps compression with file output.
+ * For details and updates please visit
+ * https://github.com/gildor2/fast_zlib
+ * Licensed under the BSD license. See LICENSE.txt file in the project root for full license information.
+ */
+
+#ifndef GZWRITE_ASYNC_H
+#define GZWRITE_ASYNC_H
+
+#include "zlib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* gzwrite() compresses data and writes it to the file from the same thread, so
+ * compression stalls while write() is blocked. This writer produces the same gzip
+ * files, but compressed data goes to one of two output buffers: while one buffer
+ * is filled by deflate(), the other one is being written asynchronously. Writes
+ * are performed with io_uring on Linux, when the kernel allows it; otherwise a
+ * dedicated writer thread is used.
+ *
+ * A file object should be used from one thread only.
+ */
+
+typedef struct gz_async_s *gzAsyncFile;
+
+ZEXTERN gzAsyncFile ZEXPORT gzAsyncOpen OF((const char *path, const char *mode));
+/* Create a gzip file for writing. mode is the same as for gzopen(), but it should
+ * be a write mode: "wb6", "wb1h" etc. Append mode and transparent writing ('T')
+ * are not supported. Returns NULL if the file couldn't be opened or created.
+ */
+
+ZEXTERN int ZEXPORT gzAsyncWrite OF((gzAsyncFile file, voidpc buf, unsigned len));
+/* Compress and write data, returns the number of uncompressed bytes written or 0
+ * in case of error, the same as gzwrite().
+ */
+
+ZEXTERN int ZEXPORT gzAsyncClose OF((gzAsyncFile file));
+/* Finish compression, wait for all writes and close the file. Returns Z_OK or
+ * Z_ERRNO when some write has failed.
+ */
+
+ZEXTERN const char * ZEXPORT gzAsyncBackend OF((gzAsyncFile file));
+/* Name of the used write mechanism: "io_uring" or "thread". */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GZWRITE_ASYNC_H */
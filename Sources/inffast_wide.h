@@ -0,0 +1,281 @@
+/*
+ * inflate_fast() with 64-bit bit buffer and wide match copies.
+ * For details and updates please visit
+ * https://github.com/gildor2/fast_zlib
+ * Licensed under the BSD license. See LICENSE.txt file in the project root for full license information.
+ */
+
+/* This file should be included after inffast.c with its inflate_fast() renamed to inflate_fast_generic,
+ * see Test/inffast_stub.c. Differences from the original code:
+ * - bit buffer is 64-bit and is refilled once per decoded symbol with a single unaligned 8-byte load, one
+ *   refill is enough for the longest length/distance pair (48 bits);
+ * - matches are copied from the output buffer with 16 or 8-byte chunks, which may write up to 15 bytes
+ *   after the match end, so more free output space is required than for the original code.
+ * The original function is used when there's not enough input or output space for the fast loop.
+ */
+
+/* Maximal number of bytes written after the end of a match */
+#define WIDE_COPY_SLOP      15
+
+typedef unsigned long long bitbuf_t;
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__) || \
+    (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+
+local bitbuf_t load64(p)
+    z_const unsigned char FAR *p;
+{
+    bitbuf_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+#else
+
+local bitbuf_t load64(p)
+    z_const unsigned char FAR *p;
+{
+    return (bitbuf_t)p[0]         | ((bitbuf_t)p[1] << 8)  | ((bitbuf_t)p[2] << 16) | ((bitbuf_t)p[3] << 24) |
+          ((bitbuf_t)p[4] << 32)  | ((bitbuf_t)p[5] << 40) | ((bitbuf_t)p[6] << 48) | ((bitbuf_t)p[7] << 56);
+}
+
+#endif
+
+/* Fill the bit buffer up to 56..63 bits. Bits above "bits" may receive a copy of the next input bits,
+ * these bits will be or'ed with the same values on the next refill, so that's safe.
+ */
+#define REFILL() \
+    do { \
+        hold |= load64(in) << bits; \
+        in += (63 - bits) >> 3; \
+        bits |= 56; \
+    } while (0)
+
+/* Copy a match of len bytes located dist bytes back from out, return the new output pointer */
+local unsigned char FAR *copy_match(out, dist, len)
+    unsigned char FAR *out;
+    unsigned dist;
+    unsigned len;
+{
+    unsigned char FAR *from = out - dist;
+    unsigned char FAR *stop = out + len;
+
+    if (dist >= 16) {
+        do {
+            memcpy(out, from, 16);
+            out += 16;
+            from += 16;
+        } while (out < stop);
+    }
+    else if (dist >= 8) {
+        do {
+            memcpy(out, from, 8);
+            out += 8;
+            from += 8;
+        } while (out < stop);
+    }
+    else if (dist == 1) {
+        memset(out, *from, len);
+    }
+    else {
+        do {
+            *out++ = *from++;
+        } while (--len);
+    }
+    return stop;
+}
+
+void ZLIB_INTERNAL inflate_fast(strm, start)
+z_streamp strm;
+unsigned start;         /* inflate()'s starting value for strm->avail_out */
+{
+    struct inflate_state FAR *state;
+    z_const unsigned char FAR *in;      /* local strm->next_in */
+    z_const unsigned char FAR *last;    /* have enough input while in < last */
+    unsigned char FAR *out;     /* local strm->next_out */
+    unsigned char FAR *beg;     /* inflate()'s initial strm->next_out */
+    unsigned char FAR *end;     /* while out < end, enough space available */
+#ifdef INFLATE_STRICT
+    unsigned dmax;              /* maximum distance from zlib header */
+#endif
+    unsigned wsize;             /* window size or zero if not using window */
+    unsigned whave;             /* valid bytes in the window */
+    unsigned wnext;             /* window write index */
+    unsigned char FAR *window;  /* allocated sliding window, if wsize != 0 */
+    bitbuf_t hold;              /* local strm->hold */
+    unsigned bits;              /* local strm->bits */
+    code const FAR *lcode;      /* local strm->lencode */
+    code const FAR *dcode;      /* local strm->distcode */
+    unsigned lmask;             /* mask for first level of length codes */
+    unsigned dmask;             /* mask for first level of distance codes */
+    code const *here;           /* retrieved table entry */
+    unsigned op;                /* code bits, operation, extra bits, or */
+                                /*  window position, window bytes to copy */
+    unsigned len;               /* match length, unused bytes */
+    unsigned dist;              /* match distance */
+    unsigned char FAR *from;    /* where to copy match from */
+
+    state = (struct inflate_state FAR *)strm->state;
+
+    /* fast loop requires 8 bytes of input for each refill, and extra output space for chunk copies */
+    if (strm->avail_in < 8 || strm->avail_out < 258 + WIDE_COPY_SLOP
+#ifdef INFLATE_ALLOW_INVALID_DISTANCE_TOOFAR_ARRR
+        || !state->sane
+#endif
+        ) {
+        inflate_fast_generic(strm, start);
+        return;
+    }
+
+    /* copy state to local variables */
+    in = strm->next_in;
+    last = in + (strm->avail_in - 7);
+    out = strm->next_out;
+    beg = out - (start - strm->avail_out);
+    end = out + (strm->avail_out - (257 + WIDE_COPY_SLOP));
+#ifdef INFLATE_STRICT
+    dmax = state->dmax;
+#endif
+    wsize = state->wsize;
+    whave = state->whave;
+    wnext = state->wnext;
+    window = state->window;
+    hold = state->hold;
+    bits = state->bits;
+    lcode = state->lencode;
+    dcode = state->distcode;
+    lmask = (1U << state->lenbits) - 1;
+    dmask = (1U << state->distbits) - 1;
+
+    /* decode literals and length/distances until end-of-block or not enough
+       input data or output space */
+    do {
+        REFILL();
+        here = lcode + ((unsigned)hold & lmask);
+      dolen:
+        op = (unsigned)(here->bits);
+        hold >>= op;
+        bits -= op;
+        op = (unsigned)(here->op);
+        if (op == 0) {                          /* literal */
+            Tracevv((stderr, here->val >= 0x20 && here->val < 0x7f ?
+                    "inflate:         literal '%c'\n" :
+                    "inflate:         literal 0x%02x\n", here->val));
+            *out++ = (unsigned char)(here->val);
+        }
+        else if (op & 16) {                     /* length base */
+            len = (unsigned)(here->val);
+            op &= 15;                           /* number of extra bits */
+            if (op) {
+                len += (unsigned)hold & ((1U << op) - 1);
+                hold >>= op;
+                bits -= op;
+            }
+            Tracevv((stderr, "inflate:         length %u\n", len));
+            here = dcode + ((unsigned)hold & dmask);
+          dodist:
+            op = (unsigned)(here->bits);
+            hold >>= op;
+            bits -= op;
+            op = (unsigned)(here->op);
+            if (op & 16) {                      /* distance base */
+                dist = (unsigned)(here->val);
+                op &= 15;                       /* number of extra bits */
+                dist += (unsigned)hold & ((1U << op) - 1);
+#ifdef INFLATE_STRICT
+                if (dist > dmax) {
+                    strm->msg = (char *)"invalid distance too far back";
+                    state->mode = BAD;
+                    break;
+                }
+#endif
+                hold >>= op;
+                bits -= op;
+                Tracevv((stderr, "inflate:         distance %u\n", dist));
+                op = (unsigned)(out - beg);     /* max distance in output */
+                if (dist > op) {                /* see if copy from window */
+                    op = dist - op;             /* distance back in window */
+                    if (op > whave) {
+                        if (state->sane) {
+                            strm->msg =
+                                (char *)"invalid distance too far back";
+                            state->mode = BAD;
+                            break;
+                        }
+                    }
+                    from = window;
+                    if (wnext == 0) {           /* very common case */
+                        from += wsize - op;
+                    }
+                    else if (wnext < op) {      /* wrap around window */
+                        from += wsize + wnext - op;
+                        op -= wnext;
+                        if (op < len) {         /* some from end of window */
+                            len -= op;
+                            memcpy(out, from, op);
+                            out += op;
+                            from = window;
+                            op = wnext;         /* rest of the window */
+                        }
+                    }
+                    else {                      /* contiguous in window */
+                        from += wnext - op;
+                    }
+                    if (op < len) {             /* some from window, rest from output */
+                        memcpy(out, from, op);
+                        out = copy_match(out + op, dist, len - op);
+                    }
+                    else {                      /* all from window */
+                        memcpy(out, from, len);
+                        out += len;
+                    }
+                }
+                else {
+                    out = copy_match(out, dist, len);
+                }
+            }
+            else if ((op & 64) == 0) {          /* 2nd level distance code */
+                here = dcode + here->val + ((unsigned)hold & ((1U << op) - 1));
+                goto dodist;
+            }
+            else {
+                strm->msg = (char *)"invalid distance code";
+                state->mode = BAD;
+                break;
+            }
+        }
+        else if ((op & 64) == 0) {              /* 2nd level length code */
+            here = lcode + here->val + ((unsigned)hold & ((1U << op) - 1));
+            goto dolen;
+        }
+        else if (op & 32) {                     /* end-of-block */
+            Tracevv((stderr, "inflate:         end of block\n"));
+            state->mode = TYPE;
+            break;
+        }
+        else {
+            strm->msg = (char *)"invalid literal/length code";
+            state->mode = BAD;
+            break;
+        }
+    } while (in < last && out < end);
+
+    /* return unused bytes, all of them were counted in bits */
+    len = bits >> 3;
+    in -= len;
+    bits -= len << 3;
+    hold &= ((bitbuf_t)1 << bits) - 1;
+
+    /* update state and return */
+    strm->next_in = in;
+    strm->next_out = out;
+    strm->avail_in = (unsigned)(in < last ? 7 + (last - in) : 7 - (in - last));
+    strm->avail_out = (unsigned)(out < end ?
+                                 (257 + WIDE_COPY_SLOP) + (end - out) :
+                                 (257 + WIDE_COPY_SLOP) - (out - end));
+    state->hold = (unsigned long)hold;
+    state->bits = bits;
+    return;
+}
+
+#undef REFILL
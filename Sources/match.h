@@ -17,22 +17,80 @@
 
 #endif /* PARANOID_CHECK */
 
+/* Patched deflate.c compiled with GEN_HASH provides its own accessor, which
+ * treats head[] entries of stale generations as NIL.
+ */
+#ifndef HASH_HEAD
+#define HASH_HEAD(s, h)     ((IPos)(s)->head[h])
+#endif
+
+/* When MATCH_COUNT_STEPS is defined, the number of followed hash chain links is
+ * added to match_chain_steps, which should be defined by the file including match.h.
+ */
+#ifdef MATCH_COUNT_STEPS
+extern unsigned long match_chain_steps;
+#endif
+
+/* When MATCH_BUDGET is defined as a number of hash chain links per input byte, the work of
+ * longest_match() is bounded for any input. Every call brings MATCH_BUDGET links of credit,
+ * which is accumulated up to MATCH_BUDGET_BLOCK bytes of input. Followed links and prev[]
+ * entries checked by "offset search" are paid from the credit; when it is not enough, the
+ * chain is cut and "offset search" is not used. deflate.c calls longest_match() at most once
+ * per input byte, so the work is limited by MATCH_BUDGET per byte plus one block. Requires
+ * match_work field of deflate_state added by the patch.
+ */
+#ifdef MATCH_BUDGET
+#ifndef MATCH_BUDGET_BLOCK
+#define MATCH_BUDGET_BLOCK  65536
+#endif
+#define MATCH_BUDGET_MAX    ((ulg)(MATCH_BUDGET) * MATCH_BUDGET_BLOCK)
+#endif
+
+/* Canonical match selection. Compressed data should not depend on which matcher of this project
+ * is used, so all of them (generic longest_match(), per-level and small-window versions and CGen
+ * builds) return the same length and match_start as the generic C version for the same deflate
+ * state. match32.asm should follow the rule as well, but this is not verified yet: the "DiffAsm"
+ * build of Test/test.project is needed for that, and there's no CMake target for it. The result is defined by the search order: candidates are visited along
+ * hash chains starting from the nearest one, at most max_chain_length links (a quarter of it when
+ * prev_length >= good_match), with "offset search" jumps exactly as done below; only a strictly
+ * longer match replaces the current one, so the first visited of equally long candidates wins.
+ * Search stops at nice_match, and the length is limited by lookahead. Faster kernels may compare
+ * more bytes at once, but must keep this order. MATCH_BUDGET is the only exception: the output is
+ * still deterministic for the given N, but could differ for data which exceeds the budget. The
+ * "Diff" test build verifies this rule call by call (--canonical option of the test application).
+ */
+
 /* Please retain this line */
 const char fast_lm_copyright[] = " Fast match finder for zlib, https://github.com/gildor2/fast_zlib ";
 
-uInt longest_match(s, cur_match)
+/* Force inlining of the matcher body, so constant parameters passed by
+ * specialized versions are propagated into it. Helpers are declared "static",
+ * because "local" is redefined to nothing before this file is included.
+ */
+#if defined(_MSC_VER)
+#define MATCH_INLINE        __forceinline
+#elif defined(__GNUC__)
+#define MATCH_INLINE        __inline__ __attribute__((always_inline))
+#else
+#define MATCH_INLINE
+#endif
+
+static MATCH_INLINE uInt longest_match_body(s, cur_match, chain_length, nice_match, good_match, wmask)
     deflate_state *s;
     IPos cur_match;                             /* current match */
+    unsigned chain_length;                      /* max hash chain length */
+    int nice_match;                             /* stop if match long enough */
+    uInt good_match;                            /* reduce search above this length */
+    uInt wmask;                                 /* window size - 1 */
 {
-    unsigned chain_length = s->max_chain_length;/* max hash chain length */
     register Bytef *scan = s->window + s->strstart; /* current string */
     register Bytef *match;                      /* matched string */
     register int len;                           /* length of current match */
     int best_len = s->prev_length;              /* ignore strings, shorter or of the same length */
-    int nice_match = s->nice_match;             /* stop if match long enough */
     int offset = 0;                             /* offset of current hash chain */
-    IPos limit_base = s->strstart > (IPos)MAX_DIST(s) ?
-        s->strstart - (IPos)MAX_DIST(s) : NIL;
+    IPos max_dist = (IPos)(wmask + 1 - MIN_LOOKAHEAD); /* MAX_DIST(s) */
+    IPos limit_base = s->strstart > max_dist ?
+        s->strstart - max_dist : NIL;
     /*?? are MAX_DIST matches allowed ?! */
     IPos limit = limit_base;                    /* limit will be limit_base+offset */
     /* Stop when cur_match becomes <= limit. To simplify the code,
@@ -48,9 +106,18 @@ uInt longest_match(s, cur_match)
      */
     int offs0_mode = chain_length < 64;         /* bool, mode with offset==0 */
     Posf *prev = s->prev;                       /* lists of the hash chains */
-    uInt wmask = s->w_mask;
 #ifdef PARANOID_CHECK
     int match_found = 0;
+#endif
+#if defined(MATCH_COUNT_STEPS) || defined(MATCH_BUDGET)
+    unsigned chain_start;
+#endif
+#ifdef MATCH_BUDGET
+    ulg credit;                                 /* work allowed for this call */
+    unsigned rescan = 0;                        /* prev[] and head[] entries checked by offset search */
+#define CAN_RESCAN(n)       (chain_start + rescan + (n) <= credit)
+#else
+#define CAN_RESCAN(n)       1
 #endif
 
     register Bytef *strend = s->window + s->strstart + MAX_MATCH-1;
@@ -75,16 +142,28 @@ uInt longest_match(s, cur_match)
     Assert(s->hash_bits >= 8, "Code too clever");
 
     /* Do not waste too much time if we already have a good match: */
-    if (s->prev_length >= s->good_match) {
+    if (s->prev_length >= good_match) {
         chain_length >>= 2;
     }
+#ifdef MATCH_BUDGET
+    /* pay the work of the previous call from the credit brought by this one */
+    credit = MATCH_BUDGET_MAX - (s->match_work > (MATCH_BUDGET) ? s->match_work - (MATCH_BUDGET) : 0);
+    if (chain_length >= credit) {
+        /* Out of budget: short search without "offset search" */
+        chain_length = (unsigned)credit;
+        offs0_mode = 1;
+    }
+#endif
+#if defined(MATCH_COUNT_STEPS) || defined(MATCH_BUDGET)
+    chain_start = chain_length;
+#endif
     /* Do not look for matches beyond the end of the input. This is necessary
      * to make deflate deterministic.
      */
     if ((uInt)nice_match > s->lookahead) nice_match = s->lookahead;
     Assert((ulg)s->strstart <= s->window_size-MIN_LOOKAHEAD, "need lookahead");
 
-    if (best_len >= MIN_MATCH) {
+    if (best_len >= MIN_MATCH && CAN_RESCAN(best_len - 2)) {
         /* We're continuing search (lazy evaluation).
          * Note: for deflate_fast best_len is always MIN_MATCH-1 here
          */
@@ -95,12 +174,15 @@ uInt longest_match(s, cur_match)
          * to cur_match). Note: we cannot use s->prev[strstart+1,...] immediately, because
          * these strings are not yet inserted into hash table yet.
          */
+#ifdef MATCH_BUDGET
+        rescan += best_len - 2;
+#endif
         UPDATE_HASH(s, hash, scan[1]);
         UPDATE_HASH(s, hash, scan[2]);
         for (i = 3; i <= best_len; i++) {
             UPDATE_HASH(s, hash, scan[i]);
             /* If we're starting with best_len >= 3, we can use offset search. */
-            pos = s->head[hash];
+            pos = HASH_HEAD(s, hash);
             if (pos < cur_match) {
                 offset = i - 2;
                 cur_match = pos;
@@ -180,7 +262,8 @@ uInt longest_match(s, cur_match)
             UPDATE_SCAN_END;
             /* look for better string offset */
 			/*!! TODO: check if "cur_match - offset + len < s->strstart" condition is really needed - it restricts RLE-like compression */
-            if (len > MIN_MATCH && cur_match - offset + len < s->strstart && !offs0_mode) {
+            if (len > MIN_MATCH && cur_match - offset + len < s->strstart && !offs0_mode &&
+                CAN_RESCAN(len - MIN_MATCH + 2)) {
                 /* NOTE: if deflate algorithm will perform INSERT_STRING for
                  *   a whole scan (not for scan[0] only), can remove
                  *   "cur_match + len < s->strstart" limitation and replace it
@@ -191,6 +274,9 @@ uInt longest_match(s, cur_match)
                 register uInt hash;
                 Bytef* scan_end;
 
+#ifdef MATCH_BUDGET
+                rescan += len - MIN_MATCH + 2;
+#endif
                 /* go back to offset 0 */
                 cur_match -= offset;
                 offset = 0;
@@ -217,7 +303,7 @@ uInt longest_match(s, cur_match)
                 UPDATE_HASH(s, hash, scan_end[0]);
                 UPDATE_HASH(s, hash, scan_end[1]);
                 UPDATE_HASH(s, hash, scan_end[2]);
-                pos = s->head[hash];
+                pos = HASH_HEAD(s, hash);
                 if (pos < cur_match) {
                     offset = len - MIN_MATCH + 1;
                     if (pos <= limit_base + offset) goto break_matching;
@@ -241,6 +327,13 @@ uInt longest_match(s, cur_match)
     } while (cur_match > limit && --chain_length != 0);
 
 break_matching: /* sorry for goto's, but such code is smaller and easier to view ... */
+#ifdef MATCH_COUNT_STEPS
+    match_chain_steps += chain_start - chain_length;
+#endif
+#ifdef MATCH_BUDGET
+    s->match_work = MATCH_BUDGET_MAX - credit + (chain_start - chain_length) + rescan;
+#endif
+#undef CAN_RESCAN
 #ifdef PARANOID_CHECK
     if (match_found) {
         static int warned = 0;
@@ -277,3 +370,102 @@ break_matching: /* sorry for goto's, but such code is smaller and easier to view
     if ((uInt)best_len <= s->lookahead) return (uInt)best_len;
     return s->lookahead;
 }
+
+uInt longest_match(s, cur_match)
+    deflate_state *s;
+    IPos cur_match;                             /* current match */
+{
+    return longest_match_body(s, cur_match, s->max_chain_length, s->nice_match, s->good_match, s->w_mask);
+}
+
+#ifdef MATCH_SELECT
+
+/* Rows of configuration_table: good_length, nice_length and max_chain for every
+ * compression level. max_lazy is not used by longest_match().
+ */
+#define MATCH_LEVELS \
+    MATCH_LEVEL(1, 4,    8,    4) \
+    MATCH_LEVEL(2, 4,   16,    8) \
+    MATCH_LEVEL(3, 4,   32,   32) \
+    MATCH_LEVEL(4, 4,   16,   16) \
+    MATCH_LEVEL(5, 8,   32,   32) \
+    MATCH_LEVEL(6, 8,  128,  128) \
+    MATCH_LEVEL(7, 8,  128,  256) \
+    MATCH_LEVEL(8, 32, 258, 1024) \
+    MATCH_LEVEL(9, 32, 258, 4096)
+
+/* Versions of longest_match() with constant parameters. offs0_mode depends on
+ * chain length only, so the compiler drops code of the unused mode as well.
+ */
+#define MATCH_LEVEL(level, good, nice, chain) \
+    static uInt longest_match_##level(deflate_state *s, IPos cur_match) \
+    { \
+        return longest_match_body(s, cur_match, chain, nice, good, s->w_mask); \
+    }
+MATCH_LEVELS
+#undef MATCH_LEVEL
+
+/* Small windows (windowBits 9..12) used by embedded and low-memory callers.
+ * Window and prev[] take 4*w_size bytes, so they stay in L1 cache, and the
+ * time is spent mostly in the matcher loop itself. These versions have
+ * constant window mask and distance limit, other parameters are read from
+ * the stream.
+ */
+#define MIN_MATCH_WBITS     9
+#define MAX_MATCH_WBITS     12
+#define MATCH_WINDOWS \
+    MATCH_WINDOW(9) \
+    MATCH_WINDOW(10) \
+    MATCH_WINDOW(11) \
+    MATCH_WINDOW(12)
+
+#define MATCH_WINDOW(bits) \
+    static uInt longest_match_w##bits(deflate_state *s, IPos cur_match) \
+    { \
+        return longest_match_body(s, cur_match, s->max_chain_length, s->nice_match, \
+                                  s->good_match, (1u << bits) - 1); \
+    }
+MATCH_WINDOWS
+#undef MATCH_WINDOW
+
+typedef uInt (*match_func) OF((deflate_state *s, IPos cur_match));
+
+static const struct {
+    ush good_length;
+    ush nice_length;
+    ush max_chain;
+    match_func func;
+} match_table[] = {
+#define MATCH_LEVEL(level, good, nice, chain) { good, nice, chain, longest_match_##level },
+MATCH_LEVELS
+#undef MATCH_LEVEL
+};
+
+static const match_func match_windows[] = {
+#define MATCH_WINDOW(bits) longest_match_w##bits,
+MATCH_WINDOWS
+#undef MATCH_WINDOW
+};
+
+/* Called by deflate.c when compression parameters are changed */
+void match_select(s)
+    deflate_state *s;
+{
+    unsigned i;
+    if (s->w_bits <= MAX_MATCH_WBITS) {
+        s->match_func = match_windows[s->w_bits - MIN_MATCH_WBITS];
+        return;
+    }
+    for (i = 0; i < sizeof(match_table) / sizeof(match_table[0]); i++) {
+        if (s->good_match == match_table[i].good_length &&
+            s->nice_match == match_table[i].nice_length &&
+            s->max_chain_length == match_table[i].max_chain) {
+            s->match_func = match_table[i].func;
+            return;
+        }
+    }
+    /* parameters were set with deflateTune() */
+    s->match_func = longest_match;
+}
+
+#endif /* MATCH_SELECT */
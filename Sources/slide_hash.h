@@ -0,0 +1,30 @@
+/*
+ * SIMD version of the slide_hash function for zlib.
+ * For details and updates please visit
+ * https://github.com/gildor2/fast_zlib
+ * Licensed under the BSD license. See LICENSE.txt file in the project root for full license information.
+ */
+
+/* This file should be included after deflate.c compiled with FAST_SLIDE_HASH,
+ * the same way as match.h.
+ */
+
+#include "slide_simd.h"
+
+void slide_hash(s)
+    deflate_state *s;
+{
+    uInt wsize = s->w_size;
+
+#ifdef GEN_HASH
+    next_hash_gen(s, 1);                    /* head[] is slid lazily */
+#else
+    slide_hash_table(s->head, s->hash_size, wsize);
+#endif
+#ifndef FASTEST
+    /* If n is not on any hash chain, prev[n] is garbage but
+     * its value will never be used.
+     */
+    slide_hash_table(s->prev, wsize, wsize);
+#endif
+}
@@ -0,0 +1,90 @@
+/*
+ * Hash table sliding kernels for deflate's slide_hash().
+ * For details and updates please visit
+ * https://github.com/gildor2/fast_zlib
+ * Licensed under the BSD license. See LICENSE.txt file in the project root for full license information.
+ */
+
+#include "cpu_features.h"
+#include "slide_simd.h"
+
+#if X86_CPU
+#include <emmintrin.h>
+#include <immintrin.h>
+#endif
+
+void slide_hash_c(unsigned short *table, unsigned n, unsigned wsize)
+{
+    /* the same loop as in original slide_hash() */
+    unsigned short *p = table + n;
+    unsigned m;
+    if (!n) return;
+    do {
+        m = *--p;
+        *p = (unsigned short)(m >= wsize ? m - wsize : 0);
+    } while (--n);
+}
+
+#if X86_CPU
+
+TARGET_SSE2
+void slide_hash_sse2(unsigned short *table, unsigned n, unsigned wsize)
+{
+    const __m128i w = _mm_set1_epi16((short)wsize);
+    __m128i *p = (__m128i*)table;
+    unsigned i;
+    /* tables are allocated with malloc(), which is 16-byte aligned on 64-bit platforms only */
+    for (i = n / 16; i > 0; i--, p += 2) {
+        __m128i v0 = _mm_loadu_si128(p);
+        __m128i v1 = _mm_loadu_si128(p + 1);
+        _mm_storeu_si128(p,     _mm_subs_epu16(v0, w));
+        _mm_storeu_si128(p + 1, _mm_subs_epu16(v1, w));
+    }
+    slide_hash_c((unsigned short*)p, n & 15, wsize);
+}
+
+TARGET_AVX2
+void slide_hash_avx2(unsigned short *table, unsigned n, unsigned wsize)
+{
+    const __m256i w = _mm256_set1_epi16((short)wsize);
+    __m256i *p = (__m256i*)table;
+    unsigned i;
+    for (i = n / 32; i > 0; i--, p += 2) {
+        __m256i v0 = _mm256_loadu_si256(p);
+        __m256i v1 = _mm256_loadu_si256(p + 1);
+        _mm256_storeu_si256(p,     _mm256_subs_epu16(v0, w));
+        _mm256_storeu_si256(p + 1, _mm256_subs_epu16(v1, w));
+    }
+    slide_hash_c((unsigned short*)p, n & 31, wsize);
+}
+
+#else
+
+/* Non-x86 platforms: no SIMD version, fall back to C code */
+void slide_hash_sse2(unsigned short *table, unsigned n, unsigned wsize)
+{
+    slide_hash_c(table, n, wsize);
+}
+
+void slide_hash_avx2(unsigned short *table, unsigned n, unsigned wsize)
+{
+    slide_hash_c(table, n, wsize);
+}
+
+#endif /* X86_CPU */
+
+slide_hash_func slide_hash_select(void)
+{
+    unsigned features = cpu_features();
+    if (features & CPU_AVX2) return slide_hash_avx2;
+    if (features & CPU_SSE2) return slide_hash_sse2;
+    return slide_hash_c;
+}
+
+void slide_hash_table(unsigned short *table, unsigned n, unsigned wsize)
+{
+    /* Deflate streams could run in several threads, so the function is not cached here:
+     * cpu_features() detects the CPU once, and the selection is cheap compared with a slide.
+     */
+    slide_hash_select()(table, n, wsize);
+}
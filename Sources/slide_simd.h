@@ -0,0 +1,33 @@
+/*
+ * Hash table sliding kernels for deflate's slide_hash().
+ * For details and updates please visit
+ * https://github.com/gildor2/fast_zlib
+ * Licensed under the BSD license. See LICENSE.txt file in the project root for full license information.
+ */
+
+#ifndef SLIDE_SIMD_H
+#define SLIDE_SIMD_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Subtract wsize from every of n entries of table, entries which are less than
+ * wsize become NIL (0). This is a saturating 16-bit subtraction, so it maps well
+ * to SIMD. n should be a multiple of 32, which is always true for deflate tables.
+ */
+typedef void (*slide_hash_func)(unsigned short *table, unsigned n, unsigned wsize);
+
+void slide_hash_c(unsigned short *table, unsigned n, unsigned wsize);
+void slide_hash_sse2(unsigned short *table, unsigned n, unsigned wsize);
+void slide_hash_avx2(unsigned short *table, unsigned n, unsigned wsize);
+
+/* The fastest kernel supported by the current CPU */
+slide_hash_func slide_hash_select(void);
+void slide_hash_table(unsigned short *table, unsigned n, unsigned wsize);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SLIDE_SIMD_H */
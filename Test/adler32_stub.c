@@ -0,0 +1,36 @@
+/*
+ * This is a stub file which allows to use SIMD adler32 function without modification of original Zlib code.
+ */
+
+/* Rename original functions, they're used for short buffers and unsupported CPUs */
+#define adler32   adler32_generic
+#define adler32_z adler32_z_generic
+#include "adler32.c"
+#undef adler32
+#undef adler32_z
+
+#include "../Sources/cpu_features.h"
+#include "../Sources/checksum_simd.h"
+
+uLong ZEXPORT adler32_z(adler, buf, len)
+    uLong adler;
+    const Bytef *buf;
+    z_size_t len;
+{
+#if X86_CPU
+    if (buf != Z_NULL && len >= ADLER32_SIMD_MIN_LEN) {
+        unsigned features = cpu_features();
+        if (features & CPU_AVX2) return adler32_avx2(adler, buf, len);
+        if (features & CPU_SSSE3) return adler32_ssse3(adler, buf, len);
+    }
+#endif
+    return adler32_z_generic(adler, buf, len);
+}
+
+uLong ZEXPORT adler32(adler, buf, len)
+    uLong adler;
+    const Bytef *buf;
+    uInt len;
+{
+    return adler32_z(adler, buf, len);
+}
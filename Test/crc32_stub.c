@@ -0,0 +1,39 @@
+/*
+ * This is a stub file which allows to use SIMD crc32 function without modification of original Zlib code.
+ */
+
+/* Rename original functions, they're used for short buffers and unsupported CPUs */
+#define crc32   crc32_generic
+#define crc32_z crc32_z_generic
+#include "crc32.c"
+#undef crc32
+#undef crc32_z
+
+#include "../Sources/cpu_features.h"
+#include "../Sources/checksum_simd.h"
+
+uLong ZEXPORT crc32_z(crc, buf, len)
+    uLong crc;
+    const Bytef *buf;
+    z_size_t len;
+{
+#if X86_CPU
+    if (buf != Z_NULL && len >= CRC32_SIMD_MIN_LEN &&
+        (cpu_features() & (CPU_PCLMUL|CPU_SSE41)) == (CPU_PCLMUL|CPU_SSE41)) {
+        z_size_t chunk = len & ~(z_size_t)15;
+        crc = crc32_pclmul(crc, buf, chunk);
+        buf += chunk;
+        len -= chunk;
+        if (len == 0) return crc;
+    }
+#endif
+    return crc32_z_generic(crc, buf, len);
+}
+
+uLong ZEXPORT crc32(crc, buf, len)
+    uLong crc;
+    const Bytef *buf;
+    uInt len;
+{
+    return crc32_z(crc, buf, len);
+}
@@ -9,9 +9,19 @@
 #undef local
 #define local
 
+#ifdef MATCH_SELECT
+/* deflate.c calls longest_match through the pointer, see match_select() */
+#undef longest_match
+#endif
+
 /* Include our match algorithm */
 #include "../Sources/match.h"
 
+#ifdef FAST_SLIDE_HASH
+/* SIMD version of slide_hash, requires patched zlib */
+#include "../Sources/slide_hash.h"
+#endif
+
 void match_init()
 {
 }
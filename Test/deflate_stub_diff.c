@@ -0,0 +1,613 @@
+/*
+ * Differential harness for longest_match implementations. zlib's own matcher, generic fast_zlib matcher and
+ * the one chosen by match_select() are called side by side for every match search. zlib's result is used for
+ * compression, so all matchers receive exactly the same sequence of calls. Statistics of differences and time
+ * spent by each matcher are printed at exit. Every matcher except zlib's must return the same results as the
+ * generic one (see "Canonical match selection" in match.h), match_harness_check() verifies this. Not thread-safe,
+ * don't use with --batch --threads.
+ *
+ * Match searches could also be recorded into a trace file together with the window and hash chains they see
+ * (match_trace_record), and replayed later against every matcher without the rest of deflate
+ * (match_trace_replay), which gives exact time per call.
+ */
+
+#define ASMV
+#define MATCH_ZLIB
+#ifndef MATCH_SELECT
+#define MATCH_SELECT                    /* deflate.c calls the matcher through s->match_func, see match_select() below */
+#endif
+#ifndef FAST_SLIDE_HASH
+#define FAST_SLIDE_HASH                 /* window sliding is tracked by slide_hash() below */
+#endif
+#include "deflate.c"
+
+/* Prevent error when "longest_match" declared as "extern" but appears "static" */
+#undef local
+#define local
+
+/* Compile our matchers under other names */
+#undef longest_match
+#define longest_match longest_match_fast
+#define match_select match_select_fast
+#include "../Sources/match.h"
+#undef longest_match
+#undef match_select
+
+#define slide_hash slide_hash_simd
+#include "../Sources/slide_hash.h"
+#undef slide_hash
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#include <intrin.h>
+#define harness_ticks()     __rdtsc()
+#define TICKS_NAME          "cycles"
+#elif defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#include <x86intrin.h>
+#define harness_ticks()     __rdtsc()
+#define TICKS_NAME          "cycles"
+#else
+static unsigned long long harness_ticks(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+#define TICKS_NAME          "ns"
+#endif
+
+#ifdef MATCH_ASM
+/* 32-bit assembly matcher from Sources/match32.asm, deflate.c doesn't call it directly */
+#define ASM_MATCHER         { "asm", longest_match },
+#else
+#define ASM_MATCHER
+void match_init()
+{
+}
+#endif
+
+typedef struct {
+    const char *name;
+    match_func func;                /* NULL for the version chosen by match_select() */
+} matcher_info;
+
+static const matcher_info matchers[] = {
+    { "zlib",   longest_match_zlib },
+    { "fast",   longest_match_fast },
+    { "select", NULL },
+    ASM_MATCHER
+};
+
+#define NUM_MATCHERS        (int)(sizeof(matchers) / sizeof(matchers[0]))
+#define CANONICAL_MATCHER   1               /* results of all others except zlib should be the same */
+
+/* cost of reading the timer, subtracted from every measurement */
+static unsigned long long tick_overhead = 0;
+
+static void harness_init_ticks(void)
+{
+    unsigned long long best = ~0ull, t0, t1;
+    int i;
+    if (tick_overhead) return;
+    for (i = 0; i < 1000; i++) {
+        t0 = harness_ticks();
+        t1 = harness_ticks();
+        if (t1 - t0 < best) best = t1 - t0;
+    }
+    tick_overhead = best ? best : 1;
+}
+
+/* Results of matchers differ in a meaningful way. match_start is garbage when
+ * nothing better than prev_length was found.
+ */
+static int match_differs(uInt len, uInt start, uInt ref_len, uInt ref_start, uInt prev_length)
+{
+    int found = len > prev_length;
+    if (found != (ref_len > prev_length)) return 1;
+    return found && (len != ref_len || start != ref_start);
+}
+
+/* ===========================================================================
+ * Side by side comparison
+ */
+
+typedef struct {
+    unsigned long long ticks;       /* time spent in the matcher */
+    unsigned long long same;        /* the same length and distance as zlib */
+    unsigned long long longer;      /* longer match than zlib */
+    unsigned long long shorter;     /* shorter match than zlib */
+    unsigned long long closer;      /* the same length at smaller distance */
+    unsigned long long farther;     /* the same length at larger distance */
+    long long len_diff;             /* sum of length differences with zlib */
+    unsigned long long not_canonical; /* result differs from the generic fast_zlib matcher */
+} matcher_stats;
+
+static matcher_stats stats[NUM_MATCHERS];
+static unsigned long long total_calls = 0;
+
+static void match_harness_report(void)
+{
+    int i;
+    if (!total_calls) return;
+    printf("\nMatchers: %llu calls, differences with zlib\n", total_calls);
+    printf("  %-8s %12s %10s %10s %10s %10s %10s %12s %12s\n",
+        "matcher", TICKS_NAME "/call", "same", "longer", "shorter", "closer", "farther", "length diff", "not canon.");
+    for (i = 0; i < NUM_MATCHERS; i++) {
+        const matcher_stats *st = &stats[i];
+        printf("  %-8s %12.1f %10llu %10llu %10llu %10llu %10llu %+12lld %12llu\n", matchers[i].name,
+            (double)st->ticks / total_calls, st->same, st->longer, st->shorter, st->closer, st->farther,
+            st->len_diff, st->not_canonical);
+    }
+}
+
+/* Returns 1 when all matchers except zlib's returned the same results as the generic one */
+int match_harness_check(void)
+{
+    int i, ok = 1;
+    for (i = 1; i < NUM_MATCHERS; i++) {
+        if (stats[i].not_canonical) {
+            printf("Error: matcher \"%s\" differs from \"%s\" in %llu of %llu calls\n", matchers[i].name,
+                matchers[CANONICAL_MATCHER].name, stats[i].not_canonical, total_calls);
+            ok = 0;
+        }
+    }
+    return ok;
+}
+
+static void trace_call_record(deflate_state *s, IPos cur_match, uInt len, uInt match_start);
+static void trace_stream_reset(deflate_state *s);
+static void trace_stream_slide(deflate_state *s);
+
+static uInt match_harness(deflate_state *s, IPos cur_match)
+{
+    uInt len[NUM_MATCHERS];
+    IPos start[NUM_MATCHERS];
+    match_func selected;
+    int i, n, first;
+
+    if (total_calls == 0) {
+        harness_init_ticks();
+        atexit(match_harness_report);
+    }
+    match_select_fast(s);
+    selected = s->match_func;
+    s->match_func = match_harness;
+
+    /* rotate the order of calls, so the first matcher doesn't always warm up the cache for others */
+    first = (int)(total_calls % NUM_MATCHERS);
+    for (n = 0; n < NUM_MATCHERS; n++) {
+        match_func func;
+        unsigned long long t0, t1;
+        i = (first + n) % NUM_MATCHERS;
+        func = matchers[i].func ? matchers[i].func : selected;
+        t0 = harness_ticks();
+        len[i] = func(s, cur_match);
+        t1 = harness_ticks();
+        start[i] = s->match_start;
+        t1 -= t0;
+        stats[i].ticks += t1 > tick_overhead ? t1 - tick_overhead : 0;
+    }
+    total_calls++;
+
+    for (i = 0; i < NUM_MATCHERS; i++) {
+        int found = len[i] > s->prev_length;
+        int found0 = len[0] > s->prev_length;
+        matcher_stats *st = &stats[i];
+        if (!match_differs(len[i], start[i], len[0], start[0], s->prev_length)) {
+            st->same++;
+        } else if (!found0 || (found && len[i] > len[0])) {
+            st->longer++;
+            st->len_diff += (long long)len[i] - (found0 ? len[0] : s->prev_length);
+        } else if (!found || len[i] < len[0]) {
+            st->shorter++;
+            st->len_diff -= (long long)len[0] - (found ? len[i] : s->prev_length);
+        } else if (start[i] > start[0]) {
+            st->closer++;
+        } else {
+            st->farther++;
+        }
+        if (match_differs(len[i], start[i], len[CANONICAL_MATCHER], start[CANONICAL_MATCHER], s->prev_length))
+            st->not_canonical++;
+    }
+
+    /* compress with zlib's result */
+    s->match_start = start[0];
+    trace_call_record(s, cur_match, len[0], start[0]);
+    return len[0];
+}
+
+/* Called by deflate.c when the stream is reset or compression parameters are changed */
+void match_select(s)
+    deflate_state *s;
+{
+    s->match_func = match_harness;
+    trace_stream_reset(s);
+}
+
+void slide_hash(s)
+    deflate_state *s;
+{
+    slide_hash_simd(s);
+    trace_stream_slide(s);
+}
+
+/* ===========================================================================
+ * Trace of match searches. The file is a sequence of chunks in native byte
+ * order, so it should be replayed on the same platform. Window, prev[] and
+ * head[] are written as differences with their state at the previous call:
+ * window changes after the previously valid data only, and hash chains are
+ * updated for strings inserted since the previous call. Everything else is
+ * reproduced by replay: sliding, and zeroing on stream reset. Z_FULL_FLUSH
+ * clears head[] behind our back and is not supported.
+ */
+
+#define TRACE_MAGIC         0x544D5A46      /* "FZMT" */
+#define TRACE_VERSION       1
+#define TRACE_ALIGN(n)      (((n) + 3) & ~3u)
+#define TRACE_GAP           8               /* max run of unchanged elements inside one chunk */
+
+enum {
+    TRACE_STATE,            /* new stream, followed by trace_geometry; all arrays are zeroed */
+    TRACE_WINDOW,           /* changed bytes of window */
+    TRACE_PREV,             /* changed entries of prev[] */
+    TRACE_HEAD,             /* changed entries of head[] */
+    TRACE_SLIDE,            /* window and hash chains were slid by w_size */
+    TRACE_CALL              /* longest_match() call, followed by trace_call */
+};
+
+typedef struct {
+    unsigned type;
+    unsigned offset;        /* first changed element */
+    unsigned count;         /* number of elements following the chunk, padded to 4 bytes */
+} trace_chunk;
+
+typedef struct {
+    uInt w_bits;
+    uInt hash_bits;
+} trace_geometry;
+
+typedef struct {
+    uInt strstart;
+    uInt lookahead;
+    uInt prev_length;
+    uInt max_chain_length;
+    uInt good_match;
+    uInt nice_match;
+    IPos cur_match;
+    uInt len;               /* result of zlib's longest_match() */
+    uInt match_start;
+    uInt input;             /* bytes of input consumed since the previous call */
+} trace_call;
+
+static FILE *trace_file = NULL;
+static deflate_state *trace_stream = NULL;  /* stream mirrored by trace_shadow */
+static deflate_state trace_shadow;          /* arrays in the state seen by replay */
+static uInt trace_pos;                      /* strstart at the previous call */
+static uInt trace_valid;                    /* window is known to be up to date before this position */
+static uLong trace_total_in;
+
+/* Allocate zeroed arrays for a stream, the same as deflateInit2() would do */
+static void trace_setup(deflate_state *s, uInt w_bits, uInt hash_bits)
+{
+    free(s->window);
+    free(s->prev);
+    free(s->head);
+    s->w_bits = w_bits;
+    s->w_size = 1 << w_bits;
+    s->w_mask = s->w_size - 1;
+    s->window_size = 2L * s->w_size;
+    s->hash_bits = hash_bits;
+    s->hash_size = 1 << hash_bits;
+    s->hash_mask = s->hash_size - 1;
+    s->hash_shift = (hash_bits + MIN_MATCH - 1) / MIN_MATCH;
+    s->window = (Bytef*)calloc(s->window_size, 1);
+    s->prev = (Posf*)calloc(s->w_size, sizeof(Pos));
+    s->head = (Posf*)calloc(s->hash_size, sizeof(Pos));
+}
+
+static void trace_release(deflate_state *s)
+{
+    free(s->window);
+    free(s->prev);
+    free(s->head);
+    s->window = Z_NULL;
+    s->prev = s->head = Z_NULL;
+}
+
+/* What fill_window() does when strstart goes too far */
+static void trace_slide(deflate_state *s)
+{
+    zmemcpy(s->window, s->window + s->w_size, s->w_size);
+    slide_hash_simd(s);
+}
+
+static void trace_write(unsigned type, unsigned offset, const void *data, unsigned count, unsigned size)
+{
+    static const Byte pad[4] = { 0 };
+    trace_chunk chunk;
+    chunk.type = type;
+    chunk.offset = offset;
+    chunk.count = count;
+    fwrite(&chunk, sizeof(chunk), 1, trace_file);
+    if (count) {
+        fwrite(data, size, count, trace_file);
+        fwrite(pad, 1, TRACE_ALIGN(count * size) - count * size, trace_file);
+    }
+}
+
+/* Write runs of elements in [from, to) which differ from the shadow copy */
+static void trace_diff(unsigned type, const void *cur, void *shadow, unsigned size, unsigned from, unsigned to)
+{
+    const Bytef *c = (const Bytef*)cur;
+    Bytef *sh = (Bytef*)shadow;
+    unsigned i = from, start, gap;
+    while (i < to) {
+        if (!memcmp(c + i * size, sh + i * size, size)) {
+            i++;
+            continue;
+        }
+        start = i;
+        for (i++, gap = 0; i < to && gap < TRACE_GAP; i++) {
+            gap = memcmp(c + i * size, sh + i * size, size) ? 0 : gap + 1;
+        }
+        i -= gap;
+        trace_write(type, start, c + start * size, i - start, size);
+        zmemcpy(sh + start * size, c + start * size, (i - start) * size);
+    }
+}
+
+/* prev[] entries and head[] slots of strings at positions [from, to] */
+static void trace_diff_strings(deflate_state *s, uInt from, uInt to)
+{
+    deflate_state *sh = &trace_shadow;
+    uInt p, h;
+    if (to - from >= s->w_size) {
+        trace_diff(TRACE_PREV, s->prev, sh->prev, sizeof(Pos), 0, s->w_size);
+        trace_diff(TRACE_HEAD, s->head, sh->head, sizeof(Pos), 0, s->hash_size);
+        return;
+    }
+    if ((from & s->w_mask) <= (to & s->w_mask)) {
+        trace_diff(TRACE_PREV, s->prev, sh->prev, sizeof(Pos), from & s->w_mask, (to & s->w_mask) + 1);
+    } else {
+        trace_diff(TRACE_PREV, s->prev, sh->prev, sizeof(Pos), from & s->w_mask, s->w_size);
+        trace_diff(TRACE_PREV, s->prev, sh->prev, sizeof(Pos), 0, (to & s->w_mask) + 1);
+    }
+    for (p = from; p <= to; p++) {
+        h = 0;
+        UPDATE_HASH(s, h, s->window[p]);
+        UPDATE_HASH(s, h, s->window[p + 1]);
+        UPDATE_HASH(s, h, s->window[p + 2]);
+        if (s->head[h] != sh->head[h]) trace_diff(TRACE_HEAD, s->head, sh->head, sizeof(Pos), h, h + 1);
+    }
+}
+
+static void trace_call_record(deflate_state *s, IPos cur_match, uInt len, uInt match_start)
+{
+    trace_call call;
+    uLong end;
+
+    if (!trace_file) return;
+
+    /* matchers read up to MAX_MATCH bytes after strstart, and a few more with unaligned loads;
+     * the whole lookahead is written at once, it doesn't change until the window is slid
+     */
+    end = s->strstart + (s->lookahead > MAX_MATCH + 8 ? s->lookahead : MAX_MATCH + 8);
+    if (end > s->window_size) end = s->window_size;
+
+    if (s != trace_stream) {
+        trace_geometry geometry;
+        geometry.w_bits = s->w_bits;
+        geometry.hash_bits = s->hash_bits;
+        trace_write(TRACE_STATE, 0, &geometry, 1, sizeof(geometry));
+        trace_setup(&trace_shadow, s->w_bits, s->hash_bits);
+        trace_diff(TRACE_WINDOW, s->window, trace_shadow.window, 1, 0, (unsigned)s->window_size);
+        trace_diff(TRACE_PREV, s->prev, trace_shadow.prev, sizeof(Pos), 0, s->w_size);
+        trace_diff(TRACE_HEAD, s->head, trace_shadow.head, sizeof(Pos), 0, s->hash_size);
+        trace_stream = s;
+    } else {
+        /* strings inserted since the previous call, with a margin for s->insert */
+        uInt from = trace_pos > MIN_MATCH ? trace_pos - MIN_MATCH : 0;
+        if (trace_valid < end)
+            trace_diff(TRACE_WINDOW, s->window, trace_shadow.window, 1, trace_valid, (unsigned)end);
+        trace_diff_strings(s, from, s->strstart);
+    }
+    trace_pos = s->strstart;
+    trace_valid = s->strstart + s->lookahead;
+    if (trace_valid > end) trace_valid = (uInt)end;
+
+    call.strstart = s->strstart;
+    call.lookahead = s->lookahead;
+    call.prev_length = s->prev_length;
+    call.max_chain_length = s->max_chain_length;
+    call.good_match = s->good_match;
+    call.nice_match = s->nice_match;
+    call.cur_match = cur_match;
+    call.len = len;
+    call.match_start = match_start;
+    call.input = (uInt)(s->strm->total_in >= trace_total_in ? s->strm->total_in - trace_total_in : s->strm->total_in);
+    trace_total_in = s->strm->total_in;
+    trace_write(TRACE_CALL, 0, &call, 1, sizeof(call));
+}
+
+static void trace_stream_reset(deflate_state *s)
+{
+    if (s == trace_stream) trace_stream = NULL;
+}
+
+static void trace_stream_slide(deflate_state *s)
+{
+    if (!trace_file || s != trace_stream) return;
+    trace_write(TRACE_SLIDE, 0, NULL, 0, 0);
+    trace_slide(&trace_shadow);
+    trace_pos = trace_pos > s->w_size ? trace_pos - s->w_size : 0;
+    trace_valid = trace_valid > s->w_size ? trace_valid - s->w_size : 0;
+}
+
+static void trace_close(void)
+{
+    if (fclose(trace_file) != 0) printf("Error: unable to write match trace\n");
+    trace_file = NULL;
+    trace_release(&trace_shadow);
+}
+
+/* Start recording of all match searches into the file */
+int match_trace_record(const char *filename)
+{
+    uInt header[2];
+    trace_file = fopen(filename, "wb");
+    if (!trace_file) return 0;
+    setvbuf(trace_file, NULL, _IOFBF, 1 << 20);
+    header[0] = TRACE_MAGIC;
+    header[1] = TRACE_VERSION;
+    fwrite(header, sizeof(header), 1, trace_file);
+    atexit(trace_close);
+    return 1;
+}
+
+typedef struct {
+    unsigned long long calls;
+    unsigned long long input;
+    unsigned long long ticks;       /* time spent in the matcher */
+    unsigned long long total_ticks; /* time of the whole pass, with applying the state */
+    double seconds;                 /* the same, measured with clock() */
+    unsigned long long mismatches;  /* results different from zlib's */
+} replay_stats;
+
+/* Run all calls from the trace against one matcher */
+static int trace_replay_pass(const Bytef *data, size_t size, match_func func, replay_stats *st)
+{
+    const Bytef *pos = data + 2 * sizeof(uInt);
+    const Bytef *end = data + size;
+    deflate_state s;
+    uInt good = 0, nice = 0, chain = 0;
+    int damaged = 0;
+    clock_t clock_a = clock();
+
+    zmemzero(&s, sizeof(s));
+    st->total_ticks = harness_ticks();
+    while (!damaged && pos + sizeof(trace_chunk) <= end) {
+        const trace_chunk *chunk = (const trace_chunk*)pos;
+        pos += sizeof(trace_chunk);
+        if (chunk->type != TRACE_STATE && !s.window) {
+            damaged = 1;
+            break;
+        }
+        switch (chunk->type) {
+        case TRACE_STATE: {
+            const trace_geometry *geometry = (const trace_geometry*)pos;
+            trace_setup(&s, geometry->w_bits, geometry->hash_bits);
+            chain = 0;
+            pos += sizeof(trace_geometry);
+            break;
+        }
+        case TRACE_WINDOW:
+            zmemcpy(s.window + chunk->offset, pos, chunk->count);
+            pos += TRACE_ALIGN(chunk->count);
+            break;
+        case TRACE_PREV:
+            zmemcpy(s.prev + chunk->offset, pos, chunk->count * sizeof(Pos));
+            pos += TRACE_ALIGN(chunk->count * sizeof(Pos));
+            break;
+        case TRACE_HEAD:
+            zmemcpy(s.head + chunk->offset, pos, chunk->count * sizeof(Pos));
+            pos += TRACE_ALIGN(chunk->count * sizeof(Pos));
+            break;
+        case TRACE_SLIDE:
+            trace_slide(&s);
+            break;
+        case TRACE_CALL: {
+            const trace_call *call = (const trace_call*)pos;
+            unsigned long long t0, t1;
+            match_func f = func;
+            uInt len;
+            pos += sizeof(trace_call);
+            s.strstart = call->strstart;
+            s.lookahead = call->lookahead;
+            s.prev_length = call->prev_length;
+            s.max_chain_length = call->max_chain_length;
+            s.good_match = call->good_match;
+            s.nice_match = (int)call->nice_match;
+            if (!func) {
+                if (chain != s.max_chain_length || good != s.good_match || nice != call->nice_match) {
+                    match_select_fast(&s);
+                    chain = s.max_chain_length;
+                    good = s.good_match;
+                    nice = call->nice_match;
+                }
+                f = s.match_func;
+            }
+            t0 = harness_ticks();
+            len = f(&s, call->cur_match);
+            t1 = harness_ticks();
+            t1 -= t0;
+            st->ticks += t1 > tick_overhead ? t1 - tick_overhead : 0;
+            st->calls++;
+            st->input += call->input;
+            if (match_differs(len, s.match_start, call->len, call->match_start, call->prev_length))
+                st->mismatches++;
+            break;
+        }
+        default:
+            damaged = 1;
+        }
+    }
+    st->total_ticks = harness_ticks() - st->total_ticks;
+    st->seconds = (double)(clock() - clock_a) / CLOCKS_PER_SEC;
+    trace_release(&s);
+    return !damaged && pos == end;
+}
+
+/* Replay the trace recorded with match_trace_record() against every matcher */
+int match_trace_replay(const char *filename)
+{
+    FILE *f;
+    Bytef *data;
+    long size;
+    int i;
+
+    f = fopen(filename, "rb");
+    if (!f) {
+        printf("Error: unable to open %s\n", filename);
+        return 0;
+    }
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    data = (Bytef*)malloc(size > 0 ? size : 1);
+    if (size < (long)(2 * sizeof(uInt)) || fread(data, size, 1, f) != 1 ||
+        ((uInt*)data)[0] != TRACE_MAGIC || ((uInt*)data)[1] != TRACE_VERSION) {
+        printf("Error: %s is not a match trace\n", filename);
+        fclose(f);
+        free(data);
+        return 0;
+    }
+    fclose(f);
+
+    harness_init_ticks();
+    for (i = 0; i < NUM_MATCHERS; i++) {
+        replay_stats st;
+        double ns_per_tick;
+        zmemzero(&st, sizeof(st));
+        if (!trace_replay_pass(data, (size_t)size, matchers[i].func, &st)) {
+            printf("Error: %s is damaged\n", filename);
+            free(data);
+            return 0;
+        }
+        if (i == 0) {
+            printf("Replaying %llu calls, %.1f Mb of input (%s)\n", st.calls, st.input / (double)(1 << 20), filename);
+            printf("  %-8s %10s %12s %12s %10s\n", "matcher", "ns/call", TICKS_NAME "/call", TICKS_NAME "/byte",
+                "mismatches");
+        }
+        if (!st.calls) break;
+        ns_per_tick = st.total_ticks ? st.seconds * 1e9 / st.total_ticks : 0;
+        printf("  %-8s %10.1f %12.1f %12.2f %10llu\n", matchers[i].name,
+            (double)st.ticks * ns_per_tick / st.calls, (double)st.ticks / st.calls,
+            st.input ? (double)st.ticks / st.input : 0.0, st.mismatches);
+    }
+    free(data);
+    return 1;
+}
@@ -0,0 +1,157 @@
+/*
+ * libFuzzer target for compress2() with the C matcher. Besides round trip check it looks for performance cliffs:
+ * inputs which make longest_match() follow too many hash chain links per input byte. Such inputs are saved to
+ * FUZZ_SLOW_DIR (current directory by default), so they could be used later for regression benchmarking.
+ * Threshold is a quarter of max_chain for the compression level (at least 4), or FUZZ_STEPS_PER_BYTE when it is set.
+ * The first byte of input selects compression level 1..9.
+ *
+ * Compiled with FUZZ_STANDALONE, this file has its own main() which runs and times files passed in the command line.
+ */
+
+#define ASMV
+#include "deflate.c"
+
+/* Prevent error when "longest_match" declared as "extern" but appears "static" */
+#undef local
+#define local
+
+#ifdef MATCH_SELECT
+/* deflate.c calls longest_match through the pointer, see match_select() */
+#undef longest_match
+#endif
+
+#define MATCH_COUNT_STEPS
+#include "../Sources/match.h"
+
+#ifdef FAST_SLIDE_HASH
+/* SIMD version of slide_hash, requires patched zlib */
+#include "../Sources/slide_hash.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+void match_init()
+{
+}
+
+unsigned long match_chain_steps = 0;
+static clock_t compress_clocks = 0;             /* time of the last compress2() call */
+
+#define FUZZ_MIN_INPUT      256         /* steps per byte are meaningless for smaller inputs */
+#define FUZZ_MAX_BUCKETS    16          /* log2 of steps per byte */
+
+#if defined(__clang__) && defined(__linux__) && !defined(FUZZ_STANDALONE)
+/* Extra coverage counters: libFuzzer keeps inputs reaching new levels of steps per byte, so it
+ * moves towards pathological inputs instead of finding them by chance.
+ */
+__attribute__((used, section("__libfuzzer_extra_counters")))
+static uint8_t fuzz_cliff_counters[10 * FUZZ_MAX_BUCKETS];
+#define FUZZ_CLIFF(level, bucket)   fuzz_cliff_counters[(level) * FUZZ_MAX_BUCKETS + (bucket)]++
+#else
+#define FUZZ_CLIFF(level, bucket)   ((void)(level), (void)(bucket))
+#endif
+
+static unsigned long fuzz_threshold(int level)
+{
+    const char *env = getenv("FUZZ_STEPS_PER_BYTE");
+    if (env && atol(env) > 0) return (unsigned long)atol(env);
+    /* low levels have so short chains, that they can't fall off a cliff */
+    return configuration_table[level].max_chain / 4 > 4 ? configuration_table[level].max_chain / 4 : 4;
+}
+
+#ifndef FUZZ_STANDALONE
+static void fuzz_save(const uint8_t *data, size_t size, int level, unsigned long steps_per_byte)
+{
+    const char *dir = getenv("FUZZ_SLOW_DIR");
+    char filename[1024];
+    uLong crc = crc32(0L, data, (uInt)size);
+    FILE *f;
+    snprintf(filename, sizeof(filename), "%s/slow-%d-%lu-%08lx.bin", dir ? dir : ".", level, steps_per_byte, crc);
+    f = fopen(filename, "wb");
+    if (!f) return;
+    fwrite(data, 1, size, f);
+    fclose(f);
+    fprintf(stderr, "performance cliff: level %d, %lu chain steps per byte, %u bytes, saved to %s\n",
+        level, steps_per_byte, (unsigned)size, filename);
+}
+#endif
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    int level, bucket;
+    uLong packed_size, unpacked_size;
+    Bytef *packed, *unpacked;
+    unsigned long steps_per_byte;
+
+    if (size < 1 || size > (1 << 24)) return 0;
+    level = data[0] % 9 + 1;
+
+    packed_size = compressBound((uLong)size);
+    packed = (Bytef*)malloc(packed_size);
+    unpacked = (Bytef*)malloc(size);
+    if (!packed || !unpacked) abort();
+
+    match_chain_steps = 0;
+    compress_clocks = clock();
+    if (compress2(packed, &packed_size, data, (uLong)size, level) != Z_OK) abort();
+    compress_clocks = clock() - compress_clocks;
+    steps_per_byte = match_chain_steps / size;
+
+    unpacked_size = (uLong)size;
+    if (uncompress(unpacked, &unpacked_size, packed, packed_size) != Z_OK) abort();
+    if (unpacked_size != size || memcmp(unpacked, data, size) != 0) abort();
+    free(packed);
+    free(unpacked);
+
+    if (size >= FUZZ_MIN_INPUT) {
+        for (bucket = 0; bucket < FUZZ_MAX_BUCKETS - 1 && (2ul << bucket) <= steps_per_byte; bucket++) {}
+        FUZZ_CLIFF(level, bucket);
+#ifndef FUZZ_STANDALONE
+        if (steps_per_byte >= fuzz_threshold(level))
+            fuzz_save(data, size, level, steps_per_byte);
+#endif
+    }
+    return 0;
+}
+
+#ifdef FUZZ_STANDALONE
+
+/* Run every input from the command line, print compression speed and steps per byte */
+int main(int argc, char **argv)
+{
+    int i;
+    for (i = 1; i < argc; i++) {
+        FILE *f = fopen(argv[i], "rb");
+        uint8_t *data;
+        long size;
+        double seconds;
+        if (!f) {
+            printf("Error: unable to open %s\n", argv[i]);
+            return 1;
+        }
+        fseek(f, 0, SEEK_END);
+        size = ftell(f);
+        fseek(f, 0, SEEK_SET);
+        data = (uint8_t*)malloc(size > 0 ? size : 1);
+        if (fread(data, 1, size, f) != (size_t)size) size = 0;
+        fclose(f);
+
+        LLVMFuzzerTestOneInput(data, (size_t)size);
+        seconds = (double)compress_clocks / CLOCKS_PER_SEC;
+        if (size) {
+            int level = data[0] % 9 + 1;
+            unsigned long steps_per_byte = match_chain_steps / size;
+            printf("%s: level %d, %ld bytes, %lu chain steps per byte%s, %.2f Mb/s\n", argv[i], level, size,
+                steps_per_byte, steps_per_byte >= fuzz_threshold(level) ? " (cliff)" : "",
+                seconds > 0 ? size / seconds / (1 << 20) : 0.0);
+        }
+        free(data);
+    }
+    return 0;
+}
+
+#endif /* FUZZ_STANDALONE */
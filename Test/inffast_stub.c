@@ -0,0 +1,10 @@
+/*
+ * This is a stub file which allows to use faster inflate_fast function without modification of original Zlib code.
+ */
+
+/* Rename original function, it's used when there's not enough data for the fast loop */
+#define inflate_fast inflate_fast_generic
+#include "inffast.c"
+#undef inflate_fast
+
+#include "../Sources/inffast_wide.h"
@@ -14,24 +14,55 @@
 #else
 #	include <dirent.h>				// for opendir() etc
 #	include <sys/stat.h>			// for stat()
+#	include <sys/mman.h>			// for mmap()
+#	include <fcntl.h>				// for open()
+#	include <unistd.h>				// for close()
+#	include <sys/time.h>			// for gettimeofday()
 #	define stricmp					strcasecmp
 #	define strnicmp					strncasecmp
 #	define PLATFORM					"unix"
 #endif
 
+#if __linux__
+#	include <linux/perf_event.h>	// for hardware performance counters
+#	include <sys/syscall.h>
+#	include <sys/ioctl.h>
+#	define HAS_PERF_COUNTERS		1
+#endif
+
 #include <vector>
 #include <string>
+#include <deque>
 
 #include "zlib.h"
+#include "../Sources/slide_simd.h"
+#include "../Sources/gzwrite_async.h"
+#include "../Sources/deflate_batch.h"
+#include "../Sources/deflate_iov.h"
+#include "../Sources/deflate_rsync.h"
+#include "../Sources/deflate_dedup.h"
+#include "../Sources/gzseek.h"
+#include "../Sources/gzindex.h"
+#include "../Sources/deflate_sliced.h"
+
+#ifdef MATCH_TRACE
+// provided by Test/deflate_stub_diff.c
+extern "C" int match_trace_record(const char* filename);
+extern "C" int match_trace_replay(const char* filename);
+extern "C" int match_harness_check();
+#endif
 
 // Defines controlling size of compressed data
 #define BUFFER_SIZE		(256<<20)
-#define MAX_ITERATIONS	1			// number of passes to fully fill buffer, i.e. total processed data size will be up to (BUFFER_SIZE * MAX_ITERATIONS)
+#define STREAM_CHUNK	(1<<20)		// size of pieces used with --stream and --mmap options
 
 #if _WIN32
 #define USE_DLL 1
 #endif
 
+// Data sizes could exceed 4Gb
+typedef long long int64;
+
 #define STR2(s) #s
 #define STR(s) STR2(s)
 
@@ -70,6 +101,14 @@ DECLARE_WRAPPER(int, gzread, (gzFile file, voidp buf, unsigned len), (file, buf,
 DECLARE_WRAPPER(int, gzclose, (gzFile file), (file))
 DECLARE_WRAPPER(int, compress2, (Bytef *dest, uLongf *destLen, const Bytef *source, uLong sourceLen, int level), (dest, destLen, source, sourceLen, level));
 DECLARE_WRAPPER(int, uncompress, (Bytef *dest, uLongf *destLen, const Bytef *source, uLong sourceLen), (dest, destLen, source, sourceLen));
+DECLARE_WRAPPER(int, deflateInit_, (z_streamp strm, int level, const char *version, int stream_size), (strm, level, version, stream_size))
+DECLARE_WRAPPER(int, deflateInit2_, (z_streamp strm, int level, int method, int windowBits, int memLevel, int strategy, const char *version, int stream_size),
+	(strm, level, method, windowBits, memLevel, strategy, version, stream_size))
+DECLARE_WRAPPER(int, deflate, (z_streamp strm, int flush), (strm, flush))
+DECLARE_WRAPPER(int, deflateEnd, (z_streamp strm), (strm))
+DECLARE_WRAPPER(int, inflateInit_, (z_streamp strm, const char *version, int stream_size), (strm, version, stream_size))
+DECLARE_WRAPPER(int, inflate, (z_streamp strm, int flush), (strm, flush))
+DECLARE_WRAPPER(int, inflateEnd, (z_streamp strm), (strm))
 
 // Hook gzip functions
 #define gzopen  gzopen_imp
@@ -78,114 +117,1312 @@ DECLARE_WRAPPER(int, uncompress, (Bytef *dest, uLongf *destLen, const Bytef *sou
 #define gzclose gzclose_imp
 #define compress2 compress2_imp
 #define uncompress uncompress_imp
+#define deflateInit_ deflateInit__imp
+#define deflateInit2_ deflateInit2__imp
+#define deflate deflate_imp
+#define deflateEnd deflateEnd_imp
+#define inflateInit_ inflateInit__imp
+#define inflate inflate_imp
+#define inflateEnd inflateEnd_imp
 
 #endif // USE_DLL
 
 std::vector<std::string> fileList;
 std::vector<std::string> fileExclude;
 
-static bool IsFileExcluded(const char* filename)
-{
-	for (int i = 0; i < fileExclude.size(); i++)
+static bool IsFileExcluded(const char* filename)
+{
+	for (int i = 0; i < fileExclude.size(); i++)
+	{
+		if (!stricmp(filename, fileExclude[i].c_str()))
+			return true;
+	}
+	return false;
+}
+
+static bool ScanDirectory(const char *dir, bool recurse = true, int baseDirLen = -1)
+{
+	char Path[1024];
+	bool res = true;
+//	printf("Scan %s\n", dir);
+	if (baseDirLen < 0)
+		baseDirLen = strlen(dir) + 1;
+
+#if USE_DLL
+	sprintf(Path, "%s/*.*", dir);
+	_finddatai64_t found;
+	intptr_t hFind = _findfirsti64(Path, &found);
+	if (hFind == -1) return true;
+	do
+	{
+		if (found.name[0] == '.') continue;			// "." or ".."
+		sprintf(Path, "%s/%s", dir, found.name);
+		if (IsFileExcluded(Path + baseDirLen)) continue;
+		// directory -> recurse
+		if (found.attrib & _A_SUBDIR)
+		{
+			if (recurse)
+				res = ScanDirectory(Path, recurse, baseDirLen);
+			else
+				res = true;
+		}
+		else
+		{
+			fileList.push_back(Path);
+			res = true;
+		}
+	} while (res && _findnexti64(hFind, &found) != -1);
+	_findclose(hFind);
+#else
+	DIR *find = opendir(dir);
+	if (!find) return true;
+	struct dirent *ent;
+	while (/*res &&*/ (ent = readdir(find)))
+	{
+		if (ent->d_name[0] == '.') continue;			// "." or ".."
+		sprintf(Path, "%s/%s", dir, ent->d_name);
+		if (IsFileExcluded(Path + baseDirLen)) continue;
+		// directory -> recurse
+		// note: using 'stat64' here because 'stat' ignores large files
+		struct stat64 buf;
+		if (stat64(Path, &buf) < 0) continue;			// or break?
+		if (S_ISDIR(buf.st_mode))
+		{
+			if (recurse)
+				res = ScanDirectory(Path, recurse, baseDirLen);
+			else
+				res = true;
+		}
+		else
+		{
+			fileList.push_back(Path);
+			res = true;
+		}
+	}
+	closedir(find);
+#endif
+	return res;
+}
+
+static unsigned char buffer[BUFFER_SIZE];
+static size_t bytesInBuffer = 0;
+static int currentFile = 0;
+static FILE* currentFileHandle = NULL;		// file which didn't fit into the buffer on previous FillBuffer() call
+
+// compressBound() of BUFFER_SIZE is slightly larger than BUFFER_SIZE
+static unsigned char compressedBuffer[BUFFER_SIZE + (BUFFER_SIZE >> 10)];
+
+static int64 GetFileSize64(const char* filename)
+{
+#if _WIN32
+	struct _stati64 buf;
+	if (_stati64(filename, &buf) < 0) return 0;
+#else
+	struct stat64 buf;
+	if (stat64(filename, &buf) < 0) return 0;
+#endif
+	return buf.st_size;
+}
+
+// Byte by byte comparison, used to check that different matchers produce identical output
+static bool FilesIdentical(const char* filename1, const char* filename2)
+{
+	FILE* f1 = fopen(filename1, "rb");
+	FILE* f2 = fopen(filename2, "rb");
+	bool identical = f1 && f2;
+	static unsigned char buf1[STREAM_CHUNK], buf2[STREAM_CHUNK];
+	while (identical)
+	{
+		size_t size1 = fread(buf1, 1, STREAM_CHUNK, f1);
+		size_t size2 = fread(buf2, 1, STREAM_CHUNK, f2);
+		if (size1 != size2 || memcmp(buf1, buf2, size1) != 0)
+			identical = false;
+		if (size1 < STREAM_CHUNK)
+			break;
+	}
+	if (f1) fclose(f1);
+	if (f2) fclose(f2);
+	return identical;
+}
+
+// Estimate how much of compression time is spent in slide_hash(). Deflate slides the
+// window every w_size bytes of input, and each slide processes head[] and prev[] tables,
+// their sizes depend on windowBits and memLevel of the stream. The share of time is shown
+// for both scalar and SIMD function, because only the deflate library knows which one it calls.
+static void MeasureSlideHash(int64 totalDataSize, float compressTime, int windowBits, int memLevel)
+{
+	const unsigned wsize = 1u << windowBits;
+	const unsigned tableSize = (1u << (memLevel + 7)) + wsize;	// head + prev
+	std::vector<unsigned short> table(tableSize);
+	const int numCalls = 2000;
+
+	slide_hash_func funcs[2] = { slide_hash_c, slide_hash_select() };
+	float callTime[2];
+	for (int f = 0; f < 2; f++)
+	{
+		// fill with values covering both branches of the slide
+		for (unsigned i = 0; i < tableSize; i++)
+			table[i] = (unsigned short)(i * 7);
+		clock_t clock_a = clock();
+		for (int i = 0; i < numCalls; i++)
+		{
+			funcs[f](&table[0], tableSize, wsize);
+			table[i % tableSize] = (unsigned short)(wsize + i);	// don't let the table become zero
+		}
+		callTime[f] = (clock() - clock_a) / (float)CLOCKS_PER_SEC / numCalls;
+	}
+
+	int64 numSlides = totalDataSize / wsize;
+	printf("   Slide: %.1f us -> %.1f us per call, %.1f%% -> %.1f%% of time",
+		callTime[0] * 1e6f, callTime[1] * 1e6f, numSlides * callTime[0] / compressTime * 100,
+		numSlides * callTime[1] / compressTime * 100);
+}
+
+// Fill the buffer with contents of the next files. Files larger than the buffer are continued on the
+// next call, so any amount of data could be processed by reusing the same buffer.
+static bool FillBuffer()
+{
+	bytesInBuffer = 0;
+
+	while (bytesInBuffer < BUFFER_SIZE)
+	{
+		FILE* f = currentFileHandle;
+		if (!f)
+		{
+			if (currentFile >= fileList.size()) break;
+			const char* filename = fileList[currentFile++].c_str();
+			f = fopen(filename, "rb");
+			if (!f) continue; // no error, skip this file
+		}
+
+		size_t bytesRead = fread(buffer + bytesInBuffer, 1, BUFFER_SIZE - bytesInBuffer, f);
+		bytesInBuffer += bytesRead;
+		if (bytesInBuffer == BUFFER_SIZE)
+		{
+			// the file could have more data
+			currentFileHandle = f;
+			break;
+		}
+		fclose(f);
+		currentFileHandle = NULL;
+	}
+
+	return (bytesInBuffer > 0);
+}
+
+// Start reading the file list from the beginning
+static void RewindFiles()
+{
+	if (currentFileHandle) fclose(currentFileHandle);
+	currentFileHandle = NULL;
+	currentFile = 0;
+}
+
+
+// Wall clock time in seconds, used to measure throughput of file output
+static double WallTime()
+{
+#if _WIN32
+	LARGE_INTEGER freq, now;
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&now);
+	return now.QuadPart / (double)freq.QuadPart;
+#else
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+#endif
+}
+
+// Hardware performance counters, counted only while zlib compresses data (--counters option).
+// Task clock is used as a group leader, because it is always available; hardware events are
+// optional, e.g. virtual machines often don't expose them.
+struct PerfCounters
+{
+	enum { TASK_CLOCK, CYCLES, INSTRUCTIONS, BRANCH_MISSES, L1D_MISSES, LLC_MISSES, NUM_COUNTERS };
+
+	bool enabled;
+	int fd[NUM_COUNTERS];
+	int64 value[NUM_COUNTERS];			// -1 when the event is not available
+
+	PerfCounters()
+	:	enabled(false)
+	{
+		for (int i = 0; i < NUM_COUNTERS; i++)
+		{
+			fd[i] = -1;
+			value[i] = -1;
+		}
+	}
+
+#if HAS_PERF_COUNTERS
+	bool Open()
+	{
+		static const unsigned long long cacheMiss = (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+		static const struct { unsigned type; unsigned long long config; } events[NUM_COUNTERS] =
+		{
+			{ PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK },
+			{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+			{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+			{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+			{ PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | cacheMiss },
+			{ PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | cacheMiss },
+		};
+		for (int i = 0; i < NUM_COUNTERS; i++)
+		{
+			struct perf_event_attr attr;
+			memset(&attr, 0, sizeof(attr));
+			attr.size = sizeof(attr);
+			attr.type = events[i].type;
+			attr.config = events[i].config;
+			attr.disabled = (i == 0);		// the whole group is enabled with the leader
+			attr.exclude_kernel = 1;
+			attr.exclude_hv = 1;
+			attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+			fd[i] = (int)syscall(__NR_perf_event_open, &attr, 0, -1, i ? fd[0] : -1, 0);
+			if (i == 0 && fd[0] < 0) return false;
+			if (fd[i] >= 0) value[i] = 0;
+		}
+		enabled = true;
+		return true;
+	}
+
+	void Start()
+	{
+		if (enabled) ioctl(fd[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+	}
+
+	void Stop()
+	{
+		if (enabled) ioctl(fd[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+	}
+
+	// Collect values, scaled when the kernel had to multiplex counters
+	void Read()
+	{
+		if (!enabled) return;
+		for (int i = 0; i < NUM_COUNTERS; i++)
+		{
+			if (fd[i] < 0) continue;
+			// value, time enabled, time running
+			unsigned long long data[3] = { 0, 0, 0 };
+			if (read(fd[i], data, sizeof(data)) != sizeof(data)) continue;
+			value[i] = (int64)data[0];
+			if (data[2] && data[2] < data[1])
+				value[i] = (int64)(data[0] * ((double)data[1] / data[2]));
+		}
+	}
+#else
+	bool Open() { return false; }
+	void Start() {}
+	void Stop() {}
+	void Read() {}
+#endif // HAS_PERF_COUNTERS
+
+	void Print(int64 dataSize)
+	{
+		static const char* names[NUM_COUNTERS] = { NULL, "Cycles/byte", "IPC", "Branch-miss/KB", "L1D-miss/KB", "LLC-miss/KB" };
+		double kb = dataSize / 1024.0;
+		bool hasHardware = false;
+		for (int i = CYCLES; i < NUM_COUNTERS; i++)
+			hasHardware |= (value[i] >= 0);
+		if (!hasHardware)
+		{
+			printf("   Counters: n/a");
+			return;
+		}
+		for (int i = CYCLES; i < NUM_COUNTERS; i++)
+		{
+			printf("   %s: ", names[i]);
+			if (value[i] < 0 || (i == INSTRUCTIONS && value[CYCLES] <= 0))
+			{
+				printf("n/a");
+				continue;
+			}
+			double v;
+			if (i == CYCLES)
+				v = (double)value[i] / dataSize;
+			else if (i == INSTRUCTIONS)
+				v = (double)value[i] / value[CYCLES];
+			else
+				v = value[i] / kb;
+			printf("%.2f", v);
+		}
+	}
+};
+
+static PerfCounters perfCounters;
+
+// Compressed file, written either with gzwrite(), with asynchronous writer (--async option), or with
+// seekable writer (--seekable option)
+static gzFile gzOut = NULL;
+static gzAsyncFile gzAsyncOut = NULL;
+static gzSeekWriter gzSeekOut = NULL;
+static double gzOutTime = 0;			// wall clock time of compression and file output
+
+static void GzipWrite(const void* data, unsigned len)
+{
+	double time_a = WallTime();
+	if (gzAsyncOut)
+		gzAsyncWrite(gzAsyncOut, data, len);
+	else if (gzSeekOut)
+		gzSeekWrite(gzSeekOut, data, len);
+	else
+		gzwrite(gzOut, data, len);
+	gzOutTime += WallTime() - time_a;
+}
+
+static int GzipClose()
+{
+	double time_a = WallTime();
+	int result = gzAsyncOut ? gzAsyncClose(gzAsyncOut) : gzSeekOut ? gzSeekClose(gzSeekOut) : gzclose(gzOut);
+	gzOutTime += WallTime() - time_a;
+	gzOut = NULL;
+	gzAsyncOut = NULL;
+	gzSeekOut = NULL;
+	return result;
+}
+
+// File mapped into memory, used with --mmap option
+struct MappedFile
+{
+	const unsigned char* data;
+	size_t size;
+};
+
+static bool MapFile(const char* filename, MappedFile& file)
+{
+	file.data = NULL;
+	file.size = 0;
+#if _WIN32
+	HANDLE hFile = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (hFile == INVALID_HANDLE_VALUE) return false;
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(hFile, &size) || size.QuadPart == 0 || (unsigned long long)size.QuadPart > (size_t)-1)
+	{
+		CloseHandle(hFile);
+		return false;
+	}
+	HANDLE hMapping = CreateFileMappingA(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(hFile);
+	if (!hMapping) return false;
+	// the view remains valid after closing the mapping handle
+	file.data = (const unsigned char*)MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(hMapping);
+	if (!file.data) return false;
+	file.size = (size_t)size.QuadPart;
+#else
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0) return false;
+	struct stat64 buf;
+	if (fstat64(fd, &buf) < 0 || buf.st_size == 0 || (unsigned long long)buf.st_size > (size_t)-1)
+	{
+		close(fd);
+		return false;
+	}
+	void* data = mmap(NULL, buf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) return false;
+	// deflate reads the file once from start to end
+	madvise(data, buf.st_size, MADV_SEQUENTIAL);
+	file.data = (const unsigned char*)data;
+	file.size = buf.st_size;
+#endif
+	return true;
+}
+
+static void UnmapFile(MappedFile& file)
+{
+	if (!file.data) return;
+#if _WIN32
+	UnmapViewOfFile(file.data);
+#else
+	munmap((void*)file.data, file.size);
+#endif
+	file.data = NULL;
+}
+
+// Compression of data which comes in pieces, used with --stream and --mmap options. Data is either
+// passed to GzipWrite() without copying, or compressed with deflate() into a small output buffer. In
+// the latter case compressed data is optionally decompressed immediately for verification.
+struct StreamCompressor
+{
+	bool gzip;
+	bool unpack;
+	z_stream zs;
+	z_stream zsUnpack;
+	unsigned char output[STREAM_CHUNK];
+	unsigned char unpacked[STREAM_CHUNK];
+	int64 inputSize;
+	int64 compressedSize;
+	int64 unpackedSize;
+	clock_t clocks;
+	clock_t unpackClocks;
+
+	void Init(bool inGzip, int level, int windowBits, int memLevel, bool inUnpack)
+	{
+		gzip = inGzip;
+		unpack = inUnpack;
+		inputSize = compressedSize = unpackedSize = 0;
+		clocks = unpackClocks = 0;
+		if (gzip) return;
+		memset(&zs, 0, sizeof(zs));
+		if (deflateInit2(&zs, level, Z_DEFLATED, windowBits, memLevel, Z_DEFAULT_STRATEGY) != Z_OK)
+		{
+			printf("   Compress ERROR: deflateInit\n");
+			exit(1);
+		}
+		if (unpack)
+		{
+			memset(&zsUnpack, 0, sizeof(zsUnpack));
+			inflateInit(&zsUnpack);
+		}
+	}
+
+	void Write(const unsigned char* data, size_t size)
+	{
+		inputSize += size;
+		if (gzip)
+		{
+			clock_t clock_a = clock();
+			perfCounters.Start();
+			// gzwrite() receives unsigned length
+			while (size > 0)
+			{
+				unsigned len = size < (1u<<30) ? (unsigned)size : (1u<<30);
+				GzipWrite(data, len);
+				data += len;
+				size -= len;
+			}
+			perfCounters.Stop();
+			clocks += clock() - clock_a;
+			return;
+		}
+		zs.next_in = (Bytef*)data;
+		while (size > 0)
+		{
+			uInt len = size < (1u<<30) ? (uInt)size : (1u<<30);
+			zs.avail_in = len;
+			Deflate(Z_NO_FLUSH);
+			size -= len;
+		}
+	}
+
+	void Finish()
+	{
+		if (gzip) return;
+		zs.avail_in = 0;
+		Deflate(Z_FINISH);
+		deflateEnd(&zs);
+		if (unpack)
+		{
+			inflateEnd(&zsUnpack);
+			if (unpackedSize != inputSize)
+			{
+				printf("   Unpack ERROR: size mismatch\n");
+				exit(1);
+			}
+		}
+	}
+
+protected:
+	void Deflate(int flush)
+	{
+		int result;
+		do
+		{
+			zs.next_out = output;
+			zs.avail_out = sizeof(output);
+			clock_t clock_a = clock();
+			perfCounters.Start();
+			result = deflate(&zs, flush);
+			perfCounters.Stop();
+			clocks += clock() - clock_a;
+			if (result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR)
+			{
+				printf("   Compress ERROR %d\n", result);
+				exit(1);
+			}
+			int len = sizeof(output) - zs.avail_out;
+			compressedSize += len;
+			if (unpack) Inflate(output, len);
+		} while (zs.avail_out == 0 || (flush == Z_FINISH && result != Z_STREAM_END));
+	}
+
+	void Inflate(const unsigned char* data, int size)
+	{
+		zsUnpack.next_in = (Bytef*)data;
+		zsUnpack.avail_in = size;
+		do
+		{
+			zsUnpack.next_out = unpacked;
+			zsUnpack.avail_out = sizeof(unpacked);
+			clock_t clock_a = clock();
+			int result = inflate(&zsUnpack, Z_NO_FLUSH);
+			unpackClocks += clock() - clock_a;
+			if (result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR)
+			{
+				printf("   Unpack ERROR %d\n", result);
+				exit(1);
+			}
+			unpackedSize += sizeof(unpacked) - zsUnpack.avail_out;
+		} while (zsUnpack.avail_out == 0);
+	}
+};
+
+static StreamCompressor streamCompressor;
+
+// Feed all files to the compressor one at a time, without collecting them in the big buffer
+static int64 StreamFiles(bool useMmap)
+{
+	int64 totalDataSize = 0;
+	for (size_t i = 0; i < fileList.size(); i++)
+	{
+		const char* filename = fileList[i].c_str();
+		if (useMmap)
+		{
+			MappedFile file;
+			if (!MapFile(filename, file)) continue; // no error, skip this file
+			streamCompressor.Write(file.data, file.size);
+			totalDataSize += file.size;
+			UnmapFile(file);
+		}
+		else
+		{
+			FILE* f = fopen(filename, "rb");
+			if (!f) continue;
+			// reuse the beginning of the big buffer, so only STREAM_CHUNK bytes of it will be touched
+			while (true)
+			{
+				size_t bytesRead = fread(buffer, 1, STREAM_CHUNK, f);
+				if (bytesRead == 0) break;
+				streamCompressor.Write(buffer, bytesRead);
+				totalDataSize += bytesRead;
+			}
+			fclose(f);
+		}
+	}
+	return totalDataSize;
+}
+
+// Compress every file as a separate message, first with compress2() for each of them, then with the batch API
+static void BatchTest(int level, int numThreads, int numPasses, bool verify)
+{
+	// load as many files as fit into the buffer
+	std::vector<deflate_batch_item> items;
+	size_t bytesLoaded = 0;
+	size_t outputSize = 0;
+	for (size_t i = 0; i < fileList.size(); i++)
+	{
+		FILE* f = fopen(fileList[i].c_str(), "rb");
+		if (!f) continue;
+		size_t bytesRead = fread(buffer + bytesLoaded, 1, BUFFER_SIZE - bytesLoaded, f);
+		fclose(f);
+		deflate_batch_item item;
+		memset(&item, 0, sizeof(item));
+		item.source = buffer + bytesLoaded;
+		item.sourceLen = bytesRead;
+		items.push_back(item);
+		bytesLoaded += bytesRead;
+		outputSize += compressBound(bytesRead);
+		if (bytesLoaded == BUFFER_SIZE) break;
+	}
+	int numItems = items.size();
+	std::vector<unsigned char> output(outputSize);
+	std::vector<unsigned char> output2(outputSize);
+
+	// compress2() for each message
+	double time_a = WallTime();
+	for (int pass = 0; pass < numPasses; pass++)
+	{
+		size_t pos = 0;
+		for (int i = 0; i < numItems; i++)
+		{
+			uLongf destLen = compressBound(items[i].sourceLen);
+			if (compress2(&output2[pos], &destLen, items[i].source, items[i].sourceLen, level) != Z_OK)
+			{
+				printf("   Compress ERROR\n");
+				exit(1);
+			}
+			pos += compressBound(items[i].sourceLen);
+		}
+	}
+	double compress2Time = WallTime() - time_a;
+
+	// batch API
+	deflate_batch* batch = deflateBatchCreate(level, MAX_WBITS, 8, Z_DEFAULT_STRATEGY, numThreads);
+	time_a = WallTime();
+	for (int pass = 0; pass < numPasses; pass++)
+	{
+		size_t pos = 0;
+		for (int i = 0; i < numItems; i++)
+		{
+			items[i].dest = &output[pos];
+			items[i].destLen = compressBound(items[i].sourceLen);
+			pos += items[i].destLen;
+		}
+		if (deflateBatchCompress(batch, &items[0], numItems) != Z_OK)
+		{
+			printf("   Batch compress ERROR\n");
+			exit(1);
+		}
+	}
+	double batchTime = WallTime() - time_a;
+	deflateBatchDestroy(batch);
+
+	int64 compressedSize = 0;
+	for (int i = 0; i < numItems; i++)
+		compressedSize += items[i].destLen;
+
+	printf("Compressed %d messages (%.1f Mb) with level %d   compress2: %.0f msg/s   batch: %.0f msg/s (%d threads)   Ratio: %.2f",
+		numItems, bytesLoaded / double(1<<20), level, numItems * numPasses / compress2Time, numItems * numPasses / batchTime,
+		numThreads, (double)bytesLoaded / compressedSize);
+
+	if (verify)
+	{
+		// output of the batch should be the same as for compress2(), and it should decompress properly
+		std::vector<unsigned char> unpacked;
+		for (int i = 0; i < numItems; i++)
+		{
+			const deflate_batch_item& item = items[i];
+			unpacked.resize(item.sourceLen + 1);
+			uLongf unpackedSize = unpacked.size();
+			size_t pos = item.dest - &output[0];
+			if (memcmp(item.dest, &output2[pos], item.destLen) != 0 ||
+				uncompress(&unpacked[0], &unpackedSize, item.dest, item.destLen) != Z_OK ||
+				unpackedSize != item.sourceLen || memcmp(&unpacked[0], item.source, item.sourceLen) != 0)
+			{
+				printf("   Unpack ERROR in message %d\n", i);
+				exit(1);
+			}
+		}
+		printf("   Verified");
+	}
+	printf("\n");
+}
+
+// Compress test data given as scattered segments of 0-64 Kb with compressIov() into output segments of 1-4 Kb, and
+// check that the result is identical to compress2() of the same data. Output segments which hold the compressed
+// data exactly, split inside the end of the stream, are checked as well.
+static void IovTest(int level)
+{
+	std::vector<unsigned char> expected(sizeof(compressedBuffer));
+	std::vector<z_iovec> source, dest;
+	clock_t compress2Clocks = 0, iovClocks = 0;
+	int64 totalDataSize = 0;
+	size_t numSegments = 0;
+	unsigned seed = 12345;
+
+	// exact fit, with the last block and the trailer split between two segments
+	RewindFiles();
+	FillBuffer();
+	{
+		uLong dataSize = bytesInBuffer < (64<<10) ? bytesInBuffer : (64<<10);
+		uLongf expectedSize = expected.size();
+		if (compress2(&expected[0], &expectedSize, buffer, dataSize, level) != Z_OK)
+		{
+			printf("   Compress ERROR\n");
+			exit(1);
+		}
+		for (uLong split = expectedSize > 8 ? expectedSize - 8 : 1; split < expectedSize; split++)
+		{
+			z_iovec in = { buffer, dataSize };
+			z_iovec out[2] = { { compressedBuffer, split }, { compressedBuffer + split, expectedSize - split } };
+			size_t compressedSize = 0;
+			int result = compressIov(out, 2, &compressedSize, &in, 1, level);
+			if (result != Z_OK || compressedSize != expectedSize || memcmp(compressedBuffer, &expected[0], expectedSize) != 0)
+			{
+				printf("   Iov ERROR %d with exact output split at %lu of %lu bytes\n", result, split, expectedSize);
+				exit(1);
+			}
+		}
+	}
+
+	RewindFiles();
+	while (FillBuffer())
+	{
+		// every 16th segment is empty
+		source.clear();
+		for (size_t pos = 0; pos < bytesInBuffer; /* nothing */)
+		{
+			seed = seed * 1103515245 + 12345;
+			size_t len = (seed >> 16) % 16 == 0 ? 0 : (seed >> 12) & 0xFFFF;
+			if (len > bytesInBuffer - pos) len = bytesInBuffer - pos;
+			z_iovec v = { buffer + pos, len };
+			source.push_back(v);
+			pos += len;
+		}
+		dest.clear();
+		for (size_t pos = 0; pos < sizeof(compressedBuffer); /* nothing */)
+		{
+			seed = seed * 1103515245 + 12345;
+			size_t len = 1024 + (seed >> 16) % 3072;
+			if (len > sizeof(compressedBuffer) - pos) len = sizeof(compressedBuffer) - pos;
+			z_iovec v = { compressedBuffer + pos, len };
+			dest.push_back(v);
+			pos += len;
+		}
+
+		clock_t clock_a = clock();
+		uLongf expectedSize = expected.size();
+		int result = compress2(&expected[0], &expectedSize, buffer, bytesInBuffer, level);
+		compress2Clocks += clock() - clock_a;
+		if (result != Z_OK)
+		{
+			printf("   Compress ERROR %d\n", result);
+			exit(1);
+		}
+
+		clock_a = clock();
+		size_t compressedSize = 0;
+		result = compressIov(&dest[0], (unsigned)dest.size(), &compressedSize, &source[0], (unsigned)source.size(), level);
+		iovClocks += clock() - clock_a;
+		if (result != Z_OK)
+		{
+			printf("   Iov compress ERROR %d\n", result);
+			exit(1);
+		}
+
+		// output segments are adjacent, so the compressed data is contiguous
+		if (compressedSize != expectedSize || memcmp(compressedBuffer, &expected[0], compressedSize) != 0)
+		{
+			printf("   Iov output is DIFFERENT from compress2()\n");
+			exit(1);
+		}
+		totalDataSize += bytesInBuffer;
+		numSegments += source.size();
+	}
+
+	printf("%6s:%d   Iov   Data: %.1f Mb   Segments: %d   compress2: %5.2f Mb/s   compressIov: %5.2f Mb/s   Identical\n",
+		STR(VERSION), level, totalDataSize / double(1<<20), (int)numSegments,
+		totalDataSize / double(1<<20) / (compress2Clocks / (float)CLOCKS_PER_SEC),
+		totalDataSize / double(1<<20) / (iovClocks / (float)CLOCKS_PER_SEC));
+}
+
+// Compress generated data which is slow for hash chain matchers: random text with a tiny alphabet has
+// a lot of candidates matching 10-20 bytes, so deflate follows full hash chains without reaching
+// nice_match, and "offset search" rescans prev[] after every longer match. Comparing the speed of a
+// build with MATCH_BUDGET (test-CBudget) with regular one shows how much work per byte is bounded.
+static void CraftedTest(int level, int numPasses, bool verify)
+{
+	static const struct
+	{
+		const char* name;
+		const char* alphabet;
+	} kinds[] =
+	{
+		{ "2 letters", "ab" },
+		{ "4 letters", "acgt" },
+		{ "16 letters", "0123456789abcdef" },
+	};
+	const int numKinds = sizeof(kinds) / sizeof(kinds[0]);
+	const int dataSize = 4<<20;
+
+	for (int k = 0; k < numKinds; k++)
+	{
+		// fixed seed, so every build compresses the same data
+		unsigned seed = 12345;
+		int alphabetSize = strlen(kinds[k].alphabet);
+		for (int i = 0; i < dataSize; i++)
+		{
+			seed = seed * 1103515245 + 12345;
+			buffer[i] = kinds[k].alphabet[(seed >> 16) % alphabetSize];
+		}
+
+		clock_t clocks = 0;
+		unsigned long compressedSize = 0;
+		for (int pass = 0; pass < numPasses; pass++)
+		{
+			clock_t clock_a = clock();
+			compressedSize = sizeof(compressedBuffer);
+			if (compress2(compressedBuffer, &compressedSize, buffer, dataSize, level) != Z_OK)
+			{
+				printf("   Compress ERROR\n");
+				exit(1);
+			}
+			clocks += clock() - clock_a;
+		}
+
+		float time = clocks / (float)CLOCKS_PER_SEC;
+		printf("%6s:%d   Crafted: %-10s   Data: %.1f Mb   Speed: %5.2f Mb/s   Ratio: %.2f", STR(VERSION), level, kinds[k].name,
+			dataSize / double(1<<20), dataSize / double(1<<20) * numPasses / time, (double)dataSize / compressedSize);
+
+		if (verify)
+		{
+			unsigned long unpackedSize = BUFFER_SIZE - dataSize;
+			if (uncompress(buffer + dataSize, &unpackedSize, compressedBuffer, compressedSize) != Z_OK ||
+				unpackedSize != dataSize || memcmp(buffer, buffer + dataSize, dataSize) != 0)
+			{
+				printf("   Unpack ERROR\n");
+				exit(1);
+			}
+			printf("   Verified");
+		}
+		printf("\n");
+	}
+}
+
+// Compress data with deflateRsync() by small pieces of input and output, and check that the result is identical to
+// compressRsync(), and that Z_BUF_ERROR is returned only when the call had nothing to do, like deflate() does.
+// Only the first 4 Mb are used, because output is produced by 61-63 bytes.
+static void RsyncStreamTest(const unsigned char* data, uLong dataSize, int level, int chunkBits)
+{
+	if (dataSize > (4<<20)) dataSize = 4<<20;
+	std::vector<unsigned char> expected(compressRsyncBound(dataSize, chunkBits));
+	uLong expectedSize = expected.size();
+	if (compressRsync(&expected[0], &expectedSize, data, dataSize, level, chunkBits) != Z_OK)
+	{
+		printf("   Stream ERROR: compressRsync\n");
+		exit(1);
+	}
+
+	std::vector<unsigned char> output(compressRsyncBound(dataSize, chunkBits));
+	z_stream strm;
+	z_rsync rs;
+	memset(&strm, 0, sizeof(strm));
+	if (deflateInit(&strm, level) != Z_OK || deflateRsyncInit(&rs, chunkBits) != Z_OK)
+	{
+		printf("   Stream ERROR: init\n");
+		exit(1);
+	}
+
+	int result = Z_OK;
+	int badReturns = 0;
+	for (int step = 0; result != Z_STREAM_END; step++)
+	{
+		if (strm.avail_in == 0 && strm.total_in < dataSize)
+		{
+			uLong len = 1000 + step % 100;
+			if (len > dataSize - strm.total_in) len = dataSize - strm.total_in;
+			strm.next_in = (Bytef*)data + strm.total_in;
+			strm.avail_in = (uInt)len;
+		}
+		if (strm.avail_out == 0)
+		{
+			strm.next_out = &output[0] + strm.total_out;
+			strm.avail_out = 61 + step % 3;
+		}
+		uLong in = strm.total_in, out = strm.total_out;
+		result = deflateRsync(&strm, &rs, strm.total_in + strm.avail_in < dataSize ? Z_NO_FLUSH : Z_FINISH);
+		if (result == Z_BUF_ERROR && (strm.total_in != in || strm.total_out != out))
+			badReturns++;
+		if (result != Z_OK && result != Z_BUF_ERROR && result != Z_STREAM_END)
+			break;
+	}
+	uLong compressedSize = strm.total_out;
+	deflateEnd(&strm);
+
+	if (result != Z_STREAM_END || badReturns || compressedSize != expectedSize ||
+		memcmp(&output[0], &expected[0], compressedSize) != 0)
+	{
+		printf("   Stream ERROR: result %d, %d calls returned Z_BUF_ERROR after progress\n", result, badReturns);
+		exit(1);
+	}
+	printf("   Stream: identical");
+}
+
+// Compare regular and rsyncable compression of the first buffer of test data: ratio, speed, and how much of
+// compressed data stays the same after a single byte of input is changed (common prefix and suffix of outputs).
+static void RsyncTest(int level, int chunkBits)
+{
+	RewindFiles();
+	FillBuffer();
+	uLong dataSize = bytesInBuffer;
+	uLong editPos = dataSize / 10;
+	std::vector<unsigned char> output[2];
+
+	for (int rsync = 0; rsync < 2; rsync++)
+	{
+		uLong compressedSize[2];
+		clock_t clocks = 0;
+		for (int edit = 0; edit < 2; edit++)
+		{
+			output[edit].resize(compressRsyncBound(dataSize, chunkBits));
+			compressedSize[edit] = output[edit].size();
+			buffer[editPos] ^= edit;
+			clock_t clock_a = clock();
+			int result = rsync
+				? compressRsync(&output[edit][0], &compressedSize[edit], buffer, dataSize, level, chunkBits)
+				: compress2(&output[edit][0], &compressedSize[edit], buffer, dataSize, level);
+			clocks += clock() - clock_a;
+			buffer[editPos] ^= edit;
+			if (result != Z_OK)
+			{
+				printf("   Compress ERROR %d\n", result);
+				exit(1);
+			}
+		}
+
+		// Adler-32 at the end of zlib stream is always different
+		const uLong trailer = 4;
+		uLong prefix = 0, suffix = 0;
+		uLong minSize = (compressedSize[0] < compressedSize[1] ? compressedSize[0] : compressedSize[1]) - trailer;
+		while (prefix < minSize && output[0][prefix] == output[1][prefix])
+			prefix++;
+		while (suffix < minSize - prefix &&
+			output[0][compressedSize[0] - trailer - 1 - suffix] == output[1][compressedSize[1] - trailer - 1 - suffix])
+			suffix++;
+
+		float time = clocks / (float)CLOCKS_PER_SEC;
+		printf("%6s:%d   %-7s   Data: %.1f Mb   Speed: %5.2f Mb/s   Ratio: %.3f   Unchanged after edit: %.1f%%",
+			STR(VERSION), level, rsync ? "Rsync" : "Regular", dataSize / double(1<<20), dataSize * 2 / double(1<<20) / time,
+			(double)dataSize / compressedSize[0], (prefix + suffix) * 100.0 / compressedSize[1]);
+
+		// rsyncable stream should be decompressed by regular inflate
+		unsigned long unpackedSize = BUFFER_SIZE;
+		if (uncompress(compressedBuffer, &unpackedSize, &output[0][0], compressedSize[0]) != Z_OK ||
+			unpackedSize != dataSize || memcmp(compressedBuffer, buffer, dataSize) != 0)
+		{
+			printf("   Unpack ERROR\n");
+			exit(1);
+		}
+		if (rsync)
+		{
+			RsyncStreamTest(buffer, dataSize, level, chunkBits);
+		}
+		printf("\n");
+	}
+}
+
+#if SLICED_DEFLATE_COROUTINES
+
+// Coroutine which is started immediately and keeps its frame after completion, so the caller could check it
+struct SlicedTask
+{
+	struct promise_type
+	{
+		SlicedTask get_return_object()
+		{
+			return SlicedTask(std::coroutine_handle<promise_type>::from_promise(*this));
+		}
+		std::suspend_never initial_suspend() { return {}; }
+		std::suspend_always final_suspend() noexcept { return {}; }
+		void return_void() {}
+		void unhandled_exception() { exit(1); }
+	};
+
+	std::coroutine_handle<promise_type> handle;
+
+	explicit SlicedTask(std::coroutine_handle<promise_type> inHandle)
+	:	handle(inHandle)
+	{}
+	~SlicedTask()
+	{
+		handle.destroy();
+	}
+};
+
+static SlicedTask SlicedCoroutine(SlicedDeflate& d, const SliceBudget& budget, std::deque<std::coroutine_handle<> >& queue, int& numSlices)
+{
+	numSlices = 1;
+	while (co_await d.Slice(budget, [&queue](std::coroutine_handle<> h) { queue.push_back(h); }))
+		numSlices++;
+}
+
+#endif // SLICED_DEFLATE_COROUTINES
+
+// Compress the first buffer of test data with SlicedDeflate, and check that the result is identical to compress2().
+// Reports the number of slices and the longest one. With C++20, the same is done with a coroutine which is resumed
+// from a simple run queue.
+static void SlicedTest(int level)
+{
+	RewindFiles();
+	FillBuffer();
+	uLong dataSize = bytesInBuffer;
+	std::vector<unsigned char> expected(compressBound(dataSize));
+	uLong expectedSize = expected.size();
+	if (compress2(&expected[0], &expectedSize, buffer, dataSize, level) != Z_OK)
+	{
+		printf("   Compress ERROR\n");
+		exit(1);
+	}
+
+	SliceBudget budget;
+	SlicedDeflate d;
+	std::vector<unsigned char> output;
+	d.Init(level);
+	d.Begin(buffer, dataSize, &output);
+	int numSlices = 0;
+	double longestSlice = 0;
+	double time_a = WallTime();
+	for (bool finished = false; !finished; numSlices++)
+	{
+		double slice_a = WallTime();
+		finished = d.Step(budget);
+		double sliceTime = WallTime() - slice_a;
+		if (sliceTime > longestSlice) longestSlice = sliceTime;
+	}
+	double time = WallTime() - time_a;
+
+	printf("%6s:%d   Sliced   Data: %.1f Mb   Speed: %5.2f Mb/s   Slices: %d   Longest: %.2f ms", STR(VERSION), level,
+		dataSize / double(1<<20), dataSize / double(1<<20) / time, numSlices, longestSlice * 1000);
+	if (d.Result() != Z_OK || output.size() != expectedSize || memcmp(&output[0], &expected[0], expectedSize) != 0)
+	{
+		printf("   DIFFERENT from compress2()\n");
+		exit(1);
+	}
+	printf("   Identical");
+
+#if SLICED_DEFLATE_COROUTINES
+	output.clear();
+	d.Begin(buffer, dataSize, &output);
+	std::deque<std::coroutine_handle<> > queue;
+	{
+		SlicedTask task = SlicedCoroutine(d, budget, queue, numSlices);
+		while (!queue.empty())
+		{
+			std::coroutine_handle<> h = queue.front();
+			queue.pop_front();
+			h.resume();
+		}
+		if (!task.handle.done() || d.Result() != Z_OK || output.size() != expectedSize ||
+			memcmp(&output[0], &expected[0], expectedSize) != 0)
+		{
+			printf("   Coroutine: DIFFERENT\n");
+			exit(1);
+		}
+	}
+	printf("   Coroutine: %d slices, identical", numSlices);
+#endif
+	printf("\n");
+}
+
+// Compare regular compression of the first buffer of test data with compression after long-range deduplication
+// pre-pass: ratio, speed, and how much data was replaced by references to far repeats.
+static void DedupTest(int level, int tableBits)
+{
+	RewindFiles();
+	FillBuffer();
+	uLong dataSize = bytesInBuffer;
+	std::vector<unsigned char> output(compressDedupBound(dataSize));
+
+	for (int dedup = 0; dedup < 2; dedup++)
+	{
+		uLong compressedSize = output.size();
+		clock_t clock_a = clock();
+		int result = dedup
+			? compressDedup(&output[0], &compressedSize, buffer, dataSize, level, tableBits)
+			: compress2(&output[0], &compressedSize, buffer, dataSize, level);
+		clock_t clocks = clock() - clock_a;
+		if (result != Z_OK)
+		{
+			printf("   Compress ERROR %d\n", result);
+			exit(1);
+		}
+
+		float time = clocks / (float)CLOCKS_PER_SEC;
+		printf("%6s:%d   %-7s   Data: %.1f Mb   Speed: %5.2f Mb/s   Ratio: %.3f",
+			STR(VERSION), level, dedup ? "Dedup" : "Regular", dataSize / double(1<<20), dataSize / double(1<<20) / time,
+			(double)dataSize / compressedSize);
+
+		unsigned long unpackedSize = BUFFER_SIZE;
+		clock_a = clock();
+		result = dedup
+			? uncompressDedup(compressedBuffer, &unpackedSize, &output[0], compressedSize)
+			: uncompress(compressedBuffer, &unpackedSize, &output[0], compressedSize);
+		clocks = clock() - clock_a;
+		if (result != Z_OK || unpackedSize != dataSize || memcmp(compressedBuffer, buffer, dataSize) != 0)
+		{
+			printf("   Unpack ERROR\n");
+			exit(1);
+		}
+		printf("   Unpack: %5.2f Mb/s", dataSize / double(1<<20) / (clocks / (float)CLOCKS_PER_SEC));
+
+		if (dedup)
+		{
+			uLong refs, residual;
+			uncompressDedupInfo(&output[0], compressedSize, NULL, &refs, &residual);
+			printf("   References: %lu   Deduplicated: %.1f%%", refs, (dataSize - residual) * 100.0 / dataSize);
+		}
+		printf("\n");
+	}
+}
+
+// Sequential decompression of the whole gzip file with gzread(), used as a reference for random access tests.
+// Returns wall clock time.
+static double UnpackWhole(const char* compressedFile, int64 totalDataSize, std::vector<unsigned char>& data)
+{
+	data.resize((size_t)totalDataSize);
+	double time_a = WallTime();
+	gzFile gz = gzopen(compressedFile, "rb");
+	int64 unpSize = 0;
+	while (gz && unpSize < totalDataSize)
+	{
+		int64 left = totalDataSize - unpSize;
+		int result = gzread(gz, &data[(size_t)unpSize], left < BUFFER_SIZE ? (unsigned)left : BUFFER_SIZE);
+		if (result <= 0) break;
+		unpSize += result;
+	}
+	if (gz) gzclose(gz);
+	if (unpSize != totalDataSize)
+	{
+		printf("   Unpack ERROR\n");
+		exit(1);
+	}
+	return WallTime() - time_a;
+}
+
+// Offset of a random read, fixed sequence so every run reads the same ranges
+static int64 RandomOffset(unsigned& seed, int64 totalDataSize)
+{
+	seed = seed * 1103515245 + 12345;
+	return (int64)(((unsigned long long)seed << 16 ^ seed) % (unsigned long long)totalDataSize);
+}
+
+// Incompressible data with the flush interval slightly larger than the writer's 256 KB output buffer: output of
+// Z_FULL_FLUSH doesn't fit the buffer, and every flush point should still be exactly at the sync marker.
+static void SeekFlushTest()
+{
+	const char* file = "compressed-seek-random.gz";
+	const char* indexFile = "compressed-seek-random.gz.idx";
+	const int64 interval = 262500;
+	const unsigned dataSize = 8 << 20;
+	const unsigned readSize = 4096;
+
+	std::vector<unsigned char> data(dataSize);
+	unsigned seed = 1;
+	for (unsigned i = 0; i < dataSize; i++)
+	{
+		seed = seed * 1103515245 + 12345;
+		data[i] = (unsigned char)(seed >> 24);
+	}
+
+	gzSeekWriter writer = gzSeekCreate(file, indexFile, "wb6", interval);
+	if (!writer || gzSeekWrite(writer, &data[0], dataSize) != (int)dataSize || gzSeekClose(writer) != Z_OK)
+	{
+		printf("   Seek ERROR: unable to write %s\n", file);
+		exit(1);
+	}
+
+	gzSeekReader reader = gzSeekOpen(file, indexFile);
+	std::vector<unsigned char> range(readSize);
+	for (int64 offset = 0; offset < dataSize; offset += interval)
 	{
-		if (!stricmp(filename, fileExclude[i].c_str()))
-			return true;
+		// reading right at the flush point starts inflate there
+		if (!reader || gzSeekRead(reader, offset, &range[0], readSize) != (int)readSize ||
+			memcmp(&range[0], &data[(size_t)offset], readSize) != 0)
+		{
+			printf("   Seek ERROR at flush point %lld of incompressible data\n", offset);
+			exit(1);
+		}
 	}
-	return false;
+	gzSeekCloseReader(reader);
+	remove(file);
+	remove(indexFile);
 }
 
-static bool ScanDirectory(const char *dir, bool recurse = true, int baseDirLen = -1)
+// Read random ranges of a seekable gzip file through its index, compare them with data decompressed from the
+// start of file, and compare the time of both ways.
+static void SeekTest(const char* compressedFile, const char* indexFile, int64 totalDataSize)
 {
-	char Path[1024];
-	bool res = true;
-//	printf("Scan %s\n", dir);
-	if (baseDirLen < 0)
-		baseDirLen = strlen(dir) + 1;
+	const unsigned readSize = 64 << 10;
+	const int numReads = 200;
 
-#if USE_DLL
-	sprintf(Path, "%s/*.*", dir);
-	_finddatai64_t found;
-	intptr_t hFind = _findfirsti64(Path, &found);
-	if (hFind == -1) return true;
-	do
+	// reference: sequential decompression of the whole file
+	std::vector<unsigned char> data;
+	double fullTime = UnpackWhole(compressedFile, totalDataSize, data);
+
+	gzSeekReader reader = gzSeekOpen(compressedFile, indexFile);
+	if (!reader || gzSeekSize(reader) != totalDataSize)
 	{
-		if (found.name[0] == '.') continue;			// "." or ".."
-		sprintf(Path, "%s/%s", dir, found.name);
-		if (IsFileExcluded(Path + baseDirLen)) continue;
-		// directory -> recurse
-		if (found.attrib & _A_SUBDIR)
-		{
-			if (recurse)
-				res = ScanDirectory(Path, recurse, baseDirLen);
-			else
-				res = true;
-		}
-		else
-		{
-			fileList.push_back(Path);
-			res = true;
-		}
-	} while (res && _findnexti64(hFind, &found) != -1);
-	_findclose(hFind);
-#else
-	DIR *find = opendir(dir);
-	if (!find) return true;
-	struct dirent *ent;
-	while (/*res &&*/ (ent = readdir(find)))
+		printf("   Seek ERROR: unable to open %s\n", indexFile);
+		exit(1);
+	}
+
+	std::vector<unsigned char> range(readSize);
+	unsigned seed = 12345;
+	double time_a = WallTime();
+	for (int i = 0; i < numReads; i++)
 	{
-		if (ent->d_name[0] == '.') continue;			// "." or ".."
-		sprintf(Path, "%s/%s", dir, ent->d_name);
-		if (IsFileExcluded(Path + baseDirLen)) continue;
-		// directory -> recurse
-		// note: using 'stat64' here because 'stat' ignores large files
-		struct stat64 buf;
-		if (stat64(Path, &buf) < 0) continue;			// or break?
-		if (S_ISDIR(buf.st_mode))
+		int64 offset = RandomOffset(seed, totalDataSize);
+		int64 expected = totalDataSize - offset < readSize ? totalDataSize - offset : readSize;
+		int result = gzSeekRead(reader, offset, &range[0], readSize);
+		if (result != expected || memcmp(&range[0], &data[(size_t)offset], (size_t)expected) != 0)
 		{
-			if (recurse)
-				res = ScanDirectory(Path, recurse, baseDirLen);
-			else
-				res = true;
+			printf("   Seek ERROR at offset %lld\n", offset);
+			exit(1);
 		}
-		else
+	}
+	double seekTime = WallTime() - time_a;
+
+	// sequential reads continue the same inflate stream
+	for (int64 offset = 0; offset < totalDataSize; offset += readSize)
+	{
+		int64 expected = totalDataSize - offset < readSize ? totalDataSize - offset : readSize;
+		if (gzSeekRead(reader, offset, &range[0], readSize) != expected ||
+			memcmp(&range[0], &data[(size_t)offset], (size_t)expected) != 0)
 		{
-			fileList.push_back(Path);
-			res = true;
+			printf("   Seek ERROR at offset %lld\n", offset);
+			exit(1);
 		}
 	}
-	closedir(find);
-#endif
-	return res;
-}
+	gzSeekCloseReader(reader);
 
-static unsigned char buffer[BUFFER_SIZE];
-static int bytesInBuffer = 0;
-static int currentFile = 0;
+	SeekFlushTest();
 
-static unsigned char compressedBuffer[BUFFER_SIZE+16384];
+	// without index, a read needs decompression of half of file in average
+	printf("   Seek: %.2f ms per %d Kb read, %.1f ms without index",
+		seekTime * 1000 / numReads, readSize >> 10, fullTime * 1000 / 2);
+}
 
-static bool FillBuffer()
+// Build a checkpoint index of the compressed file, save and load it, then read random ranges through it, and
+// decompress the whole file with several threads. Results are verified against gzread() output.
+static void IndexTest(const char* compressedFile, const char* indexFile, int64 totalDataSize, int span, int numThreads)
 {
-	bytesInBuffer = 0;
+	const unsigned readSize = 64 << 10;
+	const int numReads = 200;
 
-	while (bytesInBuffer < BUFFER_SIZE)
-	{
-		if (currentFile >= fileList.size()) break;
-		const char* filename = fileList[currentFile++].c_str();
-		FILE* f = fopen(filename, "rb");
-		if (!f) continue; // no error, skip this file
+	std::vector<unsigned char> data;
+	double fullTime = UnpackWhole(compressedFile, totalDataSize, data);
 
-		int bytesRead = fread(buffer + bytesInBuffer, 1, BUFFER_SIZE - bytesInBuffer, f);
-		fclose(f);
-		bytesInBuffer += bytesRead;
-//		printf("file %s %d bytes\n", filename, bytesRead);
+	gzIndex index = NULL;
+	double time_a = WallTime();
+	int result = gzIndexBuild(compressedFile, span, &index);
+	double buildTime = WallTime() - time_a;
+	if (result == Z_OK)
+	{
+		result = gzIndexSave(index, indexFile);
+		gzIndexFree(index);
+		if (result == Z_OK) result = gzIndexLoad(indexFile, &index);
+	}
+	if (result != Z_OK || gzIndexSize(index) != totalDataSize)
+	{
+		printf("   Index ERROR %d\n", result);
+		exit(1);
 	}
-//	printf("... %d bytes\n", bytesInBuffer);
 
-	return (bytesInBuffer > 0);
-}
+	std::vector<unsigned char> range(readSize);
+	unsigned seed = 12345;
+	time_a = WallTime();
+	for (int i = 0; i < numReads; i++)
+	{
+		int64 offset = RandomOffset(seed, totalDataSize);
+		int64 expected = totalDataSize - offset < readSize ? totalDataSize - offset : readSize;
+		if (gzIndexRead(index, compressedFile, offset, &range[0], readSize, 0) != expected ||
+			memcmp(&range[0], &data[(size_t)offset], (size_t)expected) != 0)
+		{
+			printf("   Index ERROR at offset %lld\n", offset);
+			exit(1);
+		}
+	}
+	double readTime = WallTime() - time_a;
 
+	// whole file at once, parts between checkpoints are decompressed in parallel
+	std::vector<unsigned char> whole((size_t)totalDataSize);
+	time_a = WallTime();
+	if (gzIndexRead(index, compressedFile, 0, &whole[0], totalDataSize, numThreads) != totalDataSize ||
+		memcmp(&whole[0], &data[0], (size_t)totalDataSize) != 0)
+	{
+		printf("   Index ERROR in parallel read\n");
+		exit(1);
+	}
+	double parallelTime = WallTime() - time_a;
 
+	printf("   Index: %lld points, %lld Kb, build %.1f ms   Read: %.2f ms per %d Kb   Parallel: %.2f Mb/s (%d threads) vs %.2f Mb/s",
+		gzIndexPoints(index), GetFileSize64(indexFile) >> 10, buildTime * 1000, readTime * 1000 / numReads, readSize >> 10,
+		totalDataSize / double(1<<20) / parallelTime, numThreads + 1, totalDataSize / double(1<<20) / fullTime);
+	gzIndexFree(index);
+}
 
 int main(int argc, const char **argv)
 {
@@ -203,7 +1440,35 @@ int main(int argc, const char **argv)
 			"  --compact         use compact output\n"
 			"  --memory          use in-memory compression instead of gzip\n"
 			"  --verify          decompress generated file for testing\n"
+			"  --compare=<file>  fail if compressed file is not identical to the specified one\n"
 			"  --delete          erase compressed file after completion\n"
+			"  --stream          read files one at a time by small pieces instead of collecting them in memory\n"
+			"  --mmap            map files into memory and compress them one at a time\n"
+			"  --async           write gzip file asynchronously, overlapping compression with output\n"
+			"  --batch           compress every file separately, measure messages per second\n"
+			"  --iov             compress data in scattered segments with compressIov(), compare with compress2()\n"
+			"  --sliced          compress data in time-bounded slices with SlicedDeflate, compare with compress2()\n"
+			"  --threads=<N>     number of additional threads for --batch and --index, default 0\n"
+			"  --wbits=<9-15>    window size for --stream and --mmap, implies --memory, default 15\n"
+			"  --memlevel=<1-9>  memory level for --stream and --mmap, implies --memory, default 8\n"
+			"  --repeat=<N>      process all data N times as a single stream, to measure long-run speed\n"
+			"  --slide           estimate time spent in slide_hash(), scalar vs SIMD\n"
+			"  --crafted         compress generated data which is slow for the matcher, directory is not needed\n"
+			"  --rsync[=<bits>]  compare regular and rsyncable compression, average chunk is 2^bits, default 13\n"
+			"  --dedup[=<bits>]  compare regular compression with long-range deduplication pre-pass, hash table\n"
+			"                    has 2^bits entries, default 22\n"
+			"  --seekable[=<Kb>] write gzip file with an index of flush points every <Kb> of data, default 1024,\n"
+			"                    and measure random access reads\n"
+			"  --index[=<Kb>]    build checkpoint index of the gzip file every <Kb> of data, default 1024, measure\n"
+			"                    random access reads and parallel decompression with --threads\n"
+#if HAS_PERF_COUNTERS
+			"  --counters        report hardware performance counters of compression\n"
+#endif
+#ifdef MATCH_TRACE
+			"  --trace=<file>    record all longest_match() calls into a file\n"
+			"  --replay=<file>   run recorded calls against every matcher, directory is not needed\n"
+			"  --canonical       fail if any matcher returns a result different from the generic C one\n"
+#endif
 		);
 		return 1;
 	}
@@ -211,14 +1476,37 @@ int main(int argc, const char **argv)
 	// parse command line
 	const char* dirName = NULL;
 	int level = 9;
+	int windowBits = MAX_WBITS;
+	int memLevel = 8;
+	int numPasses = 1;
 	bool compactOutput = false;
 	bool unpackFile = false;
 	bool eraseCompressedFile = false;
 	bool inMemoryCompression = false;
+	bool measureSlide = false;
+	bool useCounters = false;
+	bool streamInput = false;
+	bool mmapInput = false;
+	bool asyncOutput = false;
+	bool batchMode = false;
+	bool iovMode = false;
+	bool slicedMode = false;
+	bool craftedData = false;
+	int rsyncBits = 0;
+	int dedupBits = 0;
+	int seekInterval = 0;
+	int indexSpan = 0;
+	int numThreads = 0;
 
 #if USE_DLL
 	const char* dllName = NULL;
 #endif
+#ifdef MATCH_TRACE
+	const char* traceFile = NULL;
+	const char* replayFile = NULL;
+	bool checkCanonical = false;
+#endif
+	const char* referenceFile = NULL;
 
 	for (int i = 1; i < argc; i++)
 	{
@@ -232,6 +1520,21 @@ int main(int argc, const char **argv)
 				if (!(level < '0' || level > '9')) goto usage;
 				level = arg[6] - '0';
 			}
+			else if (!strnicmp(arg, "wbits=", 6))
+			{
+				windowBits = atoi(arg+6);
+				if (windowBits < 9 || windowBits > MAX_WBITS) goto usage;
+			}
+			else if (!strnicmp(arg, "memlevel=", 9))
+			{
+				memLevel = atoi(arg+9);
+				if (memLevel < 1 || memLevel > MAX_MEM_LEVEL) goto usage;
+			}
+			else if (!strnicmp(arg, "repeat=", 7))
+			{
+				numPasses = atoi(arg+7);
+				if (numPasses < 1) goto usage;
+			}
 			else if (!strnicmp(arg, "exclude=", 8))
 			{
 				fileExclude.push_back(arg+8);
@@ -248,10 +1551,107 @@ int main(int argc, const char **argv)
 			{
 				eraseCompressedFile = true;
 			}
+			else if (!strnicmp(arg, "compare=", 8))
+			{
+				referenceFile = arg+8;
+			}
 			else if (!stricmp(arg, "memory"))
 			{
 				inMemoryCompression = true;
 			}
+			else if (!stricmp(arg, "slide"))
+			{
+				measureSlide = true;
+			}
+#if HAS_PERF_COUNTERS
+			else if (!stricmp(arg, "counters"))
+			{
+				useCounters = true;
+			}
+#endif
+			else if (!stricmp(arg, "stream"))
+			{
+				streamInput = true;
+			}
+			else if (!stricmp(arg, "mmap"))
+			{
+				mmapInput = true;
+			}
+			else if (!stricmp(arg, "async"))
+			{
+				asyncOutput = true;
+			}
+			else if (!stricmp(arg, "batch"))
+			{
+				batchMode = true;
+			}
+			else if (!stricmp(arg, "iov"))
+			{
+				iovMode = true;
+			}
+			else if (!stricmp(arg, "sliced"))
+			{
+				slicedMode = true;
+			}
+			else if (!stricmp(arg, "crafted"))
+			{
+				craftedData = true;
+			}
+			else if (!stricmp(arg, "rsync"))
+			{
+				rsyncBits = Z_RSYNC_DEFAULT_BITS;
+			}
+			else if (!strnicmp(arg, "rsync=", 6))
+			{
+				rsyncBits = atoi(arg+6);
+				if (rsyncBits < 8 || rsyncBits > 24) goto usage;
+			}
+			else if (!stricmp(arg, "dedup"))
+			{
+				dedupBits = Z_DEDUP_DEFAULT_BITS;
+			}
+			else if (!strnicmp(arg, "dedup=", 6))
+			{
+				dedupBits = atoi(arg+6);
+				if (dedupBits < 16 || dedupBits > 28) goto usage;
+			}
+			else if (!stricmp(arg, "seekable"))
+			{
+				seekInterval = GZ_SEEK_DEFAULT_INTERVAL;
+			}
+			else if (!strnicmp(arg, "seekable=", 9))
+			{
+				seekInterval = atoi(arg+9) << 10;
+				if (seekInterval <= 0) goto usage;
+			}
+			else if (!stricmp(arg, "index"))
+			{
+				indexSpan = GZ_INDEX_DEFAULT_SPAN;
+			}
+			else if (!strnicmp(arg, "index=", 6))
+			{
+				indexSpan = atoi(arg+6) << 10;
+				if (indexSpan <= 0) goto usage;
+			}
+			else if (!strnicmp(arg, "threads=", 8))
+			{
+				numThreads = atoi(arg+8);
+				if (numThreads < 0) goto usage;
+			}
+#ifdef MATCH_TRACE
+			else if (!strnicmp(arg, "trace=", 6))
+			{
+				traceFile = arg+6;
+			}
+			else if (!strnicmp(arg, "replay=", 7))
+			{
+				replayFile = arg+7;
+			}
+			else if (!stricmp(arg, "canonical"))
+			{
+				checkCanonical = true;
+			}
+#endif // MATCH_TRACE
 #if USE_DLL
 			else if (!strnicmp(arg, "dll=", 4))
 			{
@@ -277,12 +1677,55 @@ int main(int argc, const char **argv)
 		}
 	}
 
+#ifdef MATCH_TRACE
+	if (replayFile)
+	{
+		return match_trace_replay(replayFile) ? 0 : 1;
+	}
+#endif
+
+	if (craftedData)
+	{
+		CraftedTest(level, numPasses, unpackFile);
+		return 0;
+	}
+
 	if (!dirName)
 	{
 		printf("Error: directory name was not specified\n");
 		exit(1);
 	}
 
+	bool customWindow = (windowBits != MAX_WBITS || memLevel != 8);
+	if (customWindow)
+	{
+		// gzip and compress2() use default settings
+		if (!streamInput && !mmapInput)
+		{
+			printf("Error: --wbits and --memlevel require --stream or --mmap\n");
+			exit(1);
+		}
+		inMemoryCompression = true;
+	}
+
+	if (referenceFile && inMemoryCompression)
+	{
+		printf("Error: --compare requires gzip output, it's not compatible with --memory\n");
+		exit(1);
+	}
+
+	if (seekInterval && (inMemoryCompression || asyncOutput))
+	{
+		printf("Error: --seekable requires gzip output, it's not compatible with --memory and --async\n");
+		exit(1);
+	}
+
+	if (indexSpan && inMemoryCompression)
+	{
+		printf("Error: --index requires gzip output, it's not compatible with --memory\n");
+		exit(1);
+	}
+
 	// prepare data for compression
 	ScanDirectory(dirName);
 	if (fileList.size() == 0)
@@ -302,76 +1745,153 @@ int main(int argc, const char **argv)
 	}
 #endif // USE_DLL
 
+#ifdef MATCH_TRACE
+	if (traceFile && !match_trace_record(traceFile))
+	{
+		printf("Error: unable to create %s\n", traceFile);
+		exit(1);
+	}
+#endif
+
+	if (useCounters && !perfCounters.Open())
+	{
+		printf("Error: performance counters are not available\n");
+		exit(1);
+	}
+
+	if (batchMode)
+	{
+		BatchTest(level, numThreads, numPasses, unpackFile);
+		return 0;
+	}
+
+	if (iovMode)
+	{
+		IovTest(level);
+		return 0;
+	}
+
+	if (slicedMode)
+	{
+		SlicedTest(level);
+		return 0;
+	}
+
+	if (rsyncBits)
+	{
+		RsyncTest(level, rsyncBits);
+		return 0;
+	}
+
+	if (dedupBits)
+	{
+		DedupTest(level, dedupBits);
+		return 0;
+	}
+
 	clock_t clocks = 0;
 	clock_t unpackClocks = 0;
 
 	// open compressed stream
 	const char* compressedFile = "compressed-" STR(VERSION) "-" PLATFORM ".gz";
+	const char* indexFile = "compressed-" STR(VERSION) "-" PLATFORM ".gz.idx";
+	const char* checkpointFile = "compressed-" STR(VERSION) "-" PLATFORM ".gz.cpi";
 	gzFile gz = NULL;
 	if (!inMemoryCompression)
 	{
 		char initString[4] = "wb";
 		initString[2] = level + '0';
-		gz = gzopen(compressedFile, initString);
+		double time_a = WallTime();
+		if (asyncOutput)
+			gzAsyncOut = gzAsyncOpen(compressedFile, initString);
+		else if (seekInterval)
+			gzSeekOut = gzSeekCreate(compressedFile, indexFile, initString, seekInterval);
+		else
+			gzOut = gzopen(compressedFile, initString);
+		gzOutTime += WallTime() - time_a;
+		if (!gzOut && !gzAsyncOut && !gzSeekOut)
+		{
+			printf("Error: unable to create %s\n", compressedFile);
+			exit(1);
+		}
 	}
 
-	int iteration = 0;
-	int totalDataSize = 0;
-	int totalCompressedSize = 0;
+	int64 totalDataSize = 0;
+	int64 totalCompressedSize = 0;
 
 	// perform compression
-	while (FillBuffer() && iteration < MAX_ITERATIONS)
+	if (streamInput || mmapInput)
 	{
-		if (!inMemoryCompression)
-		{
-			clock_t clock_a = clock();
-			gzwrite(gz, buffer, bytesInBuffer);
-			clocks += clock() - clock_a;
-		}
-		else
+		streamCompressor.Init(!inMemoryCompression, level, windowBits, memLevel, unpackFile);
+		for (int pass = 0; pass < numPasses; pass++)
+			totalDataSize += StreamFiles(mmapInput);
+		streamCompressor.Finish();
+		clocks = streamCompressor.clocks;
+		unpackClocks = streamCompressor.unpackClocks;
+		totalCompressedSize = streamCompressor.compressedSize;
+	}
+	else for (int pass = 0; pass < numPasses; pass++)
+	{
+		// all passes are compressed into the same gzip stream
+		RewindFiles();
+		while (FillBuffer())
 		{
-			clock_t clock_a = clock();
-			unsigned long compressedSize = sizeof(compressedBuffer);
-			int result;
-			result = compress2(compressedBuffer, &compressedSize, buffer, bytesInBuffer, level);
-			if (result != Z_OK)
+			if (!inMemoryCompression)
 			{
-				printf("   Compress ERROR %d\n", result);
-				exit(1);
+				clock_t clock_a = clock();
+				perfCounters.Start();
+				GzipWrite(buffer, bytesInBuffer);
+				perfCounters.Stop();
+				clocks += clock() - clock_a;
 			}
-			clocks += clock() - clock_a;
-			totalCompressedSize += compressedSize;
-
-			if (unpackFile)
+			else
 			{
 				clock_t clock_a = clock();
-				unsigned long unpackedSize = BUFFER_SIZE;
-				result = uncompress(buffer, &unpackedSize, compressedBuffer, compressedSize);
+				unsigned long compressedSize = sizeof(compressedBuffer);
+				int result;
+				perfCounters.Start();
+				result = compress2(compressedBuffer, &compressedSize, buffer, bytesInBuffer, level);
+				perfCounters.Stop();
 				if (result != Z_OK)
 				{
-					printf("   Unpack ERROR %d\n", result);
+					printf("   Compress ERROR %d\n", result);
 					exit(1);
 				}
-				unpackClocks += clock() - clock_a;
+				clocks += clock() - clock_a;
+				totalCompressedSize += compressedSize;
+
+				if (unpackFile)
+				{
+					clock_t clock_a = clock();
+					unsigned long unpackedSize = BUFFER_SIZE;
+					result = uncompress(buffer, &unpackedSize, compressedBuffer, compressedSize);
+					if (result != Z_OK)
+					{
+						printf("   Unpack ERROR %d\n", result);
+						exit(1);
+					}
+					unpackClocks += clock() - clock_a;
+				}
 			}
+			totalDataSize += bytesInBuffer;
 		}
-		iteration++;
-		totalDataSize += bytesInBuffer;
 	}
 
 	// close compressed stream
+	const char* asyncBackend = gzAsyncOut ? gzAsyncBackend(gzAsyncOut) : NULL;
 	if (!inMemoryCompression)
 	{
-		gzclose(gz);
+		if (GzipClose() != Z_OK)
+		{
+			printf("Error: unable to write %s\n", compressedFile);
+			exit(1);
+		}
 	}
 
 	// determine size of compressed data
 	if (!inMemoryCompression)
 	{
-		FILE* f = fopen(compressedFile, "rb");
-		fseek(f, 0, SEEK_END);
-		totalCompressedSize = ftell(f);
-		fclose(f);
+		totalCompressedSize = GetFileSize64(compressedFile);
 	}
 
 	// print results
@@ -389,16 +1909,38 @@ int main(int argc, const char **argv)
 	{
 		printf("%6s:%d   Data: %.1f Mb   ", method, level, originalSizeMb);
 	}
-	printf("Time: %-5.1f s   Size: %d bytes   Speed: %5.2f Mb/s   Ratio: %.2f",
+	if (customWindow)
+	{
+		printf("Window: %d bits   MemLevel: %d   ", windowBits, memLevel);
+	}
+	printf("Time: %-5.1f s   Size: %lld bytes   Speed: %5.2f Mb/s   Ratio: %.2f",
 		time, totalCompressedSize, totalDataSize / double(1<<20) / time, (double)totalDataSize / totalCompressedSize);
 
+	if (!inMemoryCompression)
+	{
+		// end-to-end speed, includes waiting for the file output
+		printf("   File: %5.2f Mb/s", totalDataSize / double(1<<20) / gzOutTime);
+		if (asyncBackend) printf(" (%s)", asyncBackend);
+	}
+
+	if (measureSlide)
+	{
+		MeasureSlideHash(totalDataSize, time, windowBits, memLevel);
+	}
+
+	if (useCounters)
+	{
+		perfCounters.Read();
+		perfCounters.Print(totalDataSize);
+	}
+
 	if (unpackFile && !inMemoryCompression)
 	{
 		gz = gzopen(compressedFile, "rb");
 		clock_t clock_a = clock();
 
 		int result;
-		for (int unpSize = 0; unpSize < totalDataSize; /* nothing */)
+		for (int64 unpSize = 0; unpSize < totalDataSize; /* nothing */)
 		{
 			result = gzread(gz, buffer, BUFFER_SIZE);
 			if (result < 0)
@@ -423,6 +1965,26 @@ int main(int argc, const char **argv)
 		printf("   Unpack: %5.2f Mb/s", totalDataSize / double(1<<20) / time);
 	}
 
+	if (seekInterval)
+	{
+		SeekTest(compressedFile, indexFile, totalDataSize);
+	}
+
+	if (indexSpan)
+	{
+		IndexTest(compressedFile, checkpointFile, totalDataSize, indexSpan, numThreads);
+	}
+
+	bool identical = true;
+	if (referenceFile)
+	{
+		identical = FilesIdentical(compressedFile, referenceFile);
+		if (identical)
+			printf("   Identical");
+		else
+			printf("   DIFFERENT from %s", referenceFile);
+	}
+
 #if USE_DLL
 	if (zlibDll) printf("  (%s)", dllName);
 #endif
@@ -433,7 +1995,16 @@ int main(int argc, const char **argv)
 	if (eraseCompressedFile)
 	{
 		remove(compressedFile);
+		if (seekInterval) remove(indexFile);
+		if (indexSpan) remove(checkpointFile);
+	}
+
+#ifdef MATCH_TRACE
+	if (checkCanonical && !match_harness_check())
+	{
+		return 1;
 	}
+#endif
 
-	return 0;
+	return identical ? 0 : 1;
 }
@@ -53,9 +53,13 @@ function BuildAll()
 		Build $opt_platform $TYPE
 	else
 		Build $opt_platform "C"
+		Build $opt_platform "CGen"
+		Build $opt_platform "CBudget"
 		Build $opt_platform "Orig"
+		Build $opt_platform "Diff"
 		if [ "$opt_platform" != "vc-win64" ]; then
 			Build $opt_platform "Asm"			# no 64-bit assembly implementation
+			Build $opt_platform "DiffAsm"
 		fi
 	fi
 }
@@ -0,0 +1,59 @@
+#!/bin/bash
+
+# Profile-guided optimization build with CMake: instrument, run test application on training data, rebuild.
+# Then compare results with the regular build (-O3, the same as OPTIMIZE=speed in Test/test.project).
+# Usage: pgo.sh <training data directory> [extra cmake options]
+
+DATA=$1
+shift
+if [ ! -d "$DATA" ]; then
+	echo "Usage: pgo.sh <training data directory> [extra cmake options]"
+	exit 1
+fi
+
+PLAIN=obj/cmake-plain
+PGO=obj/cmake-pgo
+PROFILES=$(pwd)/$PGO/pgo-data
+MATCHERS="C CGen Orig"
+LEVELS="1 6 9"
+
+# Configure <build dir> [cmake options]
+function Configure()
+{
+	local dir=$1
+	shift
+	cmake -S . -B $dir -DCMAKE_BUILD_TYPE=Release -DFASTZLIB_PGO_DIR=$PROFILES "$@" > /dev/null || exit 1
+	cmake --build $dir -j 4 > /dev/null || exit 1
+}
+
+echo "---- Building regular version ----"
+Configure $PLAIN -DFASTZLIB_PGO= "$@"
+
+echo "---- Building instrumented version ----"
+rm -rf $PROFILES
+Configure $PGO -DFASTZLIB_PGO=GENERATE "$@"
+
+echo "---- Training ----"
+for m in $MATCHERS; do
+	for level in $LEVELS; do
+		$PGO/bin/test-$m "$DATA" --level=$level --memory --verify --compact > /dev/null || exit 1
+	done
+done
+$PGO/bin/test-C "$DATA" --batch --level=6 > /dev/null || exit 1
+
+# Clang writes raw profiles which should be merged
+if ls $PROFILES/*.profraw > /dev/null 2>&1; then
+	${LLVM_PROFDATA:-llvm-profdata} merge -o $PROFILES/default.profdata $PROFILES/*.profraw || exit 1
+fi
+
+echo "---- Building optimized version ----"
+Configure $PGO -DFASTZLIB_PGO=USE "$@"
+
+echo "---- Comparing ----"
+for m in $MATCHERS; do
+	for level in $LEVELS; do
+		echo "$m, level $level"
+		echo -n "  regular: "; $PLAIN/bin/test-$m "$DATA" --level=$level --memory --verify --compact
+		echo -n "  PGO:     "; $PGO/bin/test-$m "$DATA" --level=$level --memory --verify --compact
+	done
+done
@@ -5,8 +5,11 @@ platform=win32
 noorig=0		# use original C code
 noasm=0			# use asm code
 noc=0			# use optimized C code
+nogen=0			# use optimized C code with generation-tagged hash
+nobudget=1		# use optimized C code with bounded work per byte (disabled by default)
 nodll=0			# use dll with asm optimizations (original code)
 nong=0			# use zlib-ng
+nodiff=1		# compare matchers call by call (slow, disabled by default)
 extraargs="--delete --compact --memory"
 
 dllname=zlibwapi32.dll
@@ -27,6 +30,9 @@ for arg in "$@"; do		# using quoted $@ will allow to correctly separate argument
 	--noc)
 		noc=1
 		;;
+	--nogen)
+		nogen=1
+		;;
 	--noorig)
 		noorig=1
 		;;
@@ -36,26 +42,36 @@ for arg in "$@"; do		# using quoted $@ will allow to correctly separate argument
 	--nong)
 		nong=1
 		;;
+	--diff)
+		nodiff=0
+		;;
+	--budget)
+		nobudget=0
+		;;
 	--c)
 		noasm=1
+		nogen=1
 		nodll=1
 		noorig=1
 		nong=1
 		;;
 	--asm)
 		noc=1
+		nogen=1
 		nodll=1
 		noorig=1
 		nong=1
 		;;
 	--orig)
 		noc=1
+		nogen=1
 		nodll=1
 		noasm=1
 		nong=1
 		;;
 	--ng)
 		noc=1
+		nogen=1
 		noasm=1
 		nodll=1
 		noorig=1
@@ -66,7 +82,7 @@ for arg in "$@"; do		# using quoted $@ will allow to correctly separate argument
 		dllname=zlibwapi64.dll
 		dllname_ng=zlib-ng_64.dll
 		;;
-	--level=*|--exclude=*|--verify)
+	--level=*|--exclude=*|--verify|--counters|--crafted|--compare=*|--dedup|--dedup=*)
 		extraargs="$extraargs $arg"
 		;;
 	*)
@@ -76,15 +92,21 @@ for arg in "$@"; do		# using quoted $@ will allow to correctly separate argument
 			cat <<EOF
 Usage: test.sh [path] [options]
 Options:
-  --no[asm|c|orig|dll|ng]  disable particular target
+  --no[asm|c|gen|orig|dll|ng]  disable particular target
   --c                      test only C implementation
   --asm                    test only Asm implementation
   --orig                   test only original implementation
   --ng                     test only zlib-ng
+  --diff                   also run matcher comparison harness
+  --budget                 also run C implementation with bounded work per byte
   --win64                  test for 64-bit Windows
   --level=X                select compression level
   --exclude=dir            exclude directory from testing
   --verify                 unpack compressed file
+  --compare=file           check that compressed file is identical to the specified one
+  --counters               report hardware performance counters (Linux)
+  --crafted                compress generated data which is slow for matchers instead of files
+  --dedup[=bits]           compare regular compression with long-range deduplication pre-pass
 EOF
 			exit
 		fi
@@ -123,6 +145,12 @@ function DoTests
 	if [ $noc == 0 ]; then
 		obj/bin/test-C-$platform "$dir" $extraargs $*
 	fi
+	if [ $nogen == 0 ]; then
+		obj/bin/test-CGen-$platform "$dir" $extraargs $*
+	fi
+	if [ $nobudget == 0 ]; then
+		obj/bin/test-CBudget-$platform "$dir" $extraargs $*
+	fi
 	if [ $nong == 0 ]; then
 		obj/bin/test-Orig-$platform "$dir" $extraargs --dll=test/dll/$dllname_ng $*
 	fi
@@ -132,6 +160,9 @@ function DoTests
 	if [ $noorig == 0 ]; then
 		obj/bin/test-Orig-$platform "$dir" $extraargs $*
 	fi
+	if [ $nodiff == 0 ]; then
+		obj/bin/test-Diff-$platform "$dir" $extraargs $*
+	fi
 }
 
 if [ "$dir" ]; then